@@ -58,6 +58,18 @@ IconFinder::IconFinder(std::string basePath)
 {
 }
 
+/** Counts the strings we keep along with a guess at the overhead
+    of each list node */
+std::size_t IconFinder::footprint() const
+{
+    std::size_t size = sizeof(IconFinder) + _basePath.size();
+    for (const auto& path : _searchPaths)
+    {
+        size += sizeof(ThemeSubdirectory) + 2 * sizeof(void*) + path.path.size();
+    }
+    return size;
+}
+
 /** Finds an icon in the search paths that we have for this path */
 Application::Info::IconPath IconFinder::find(const std::string& iconName)
 {
@@ -53,6 +53,10 @@ public:
     */
     virtual Application::Info::IconPath find(const std::string& iconName);
 
+    /** Approximate number of bytes used by the IconFinder, for the
+        registry's memory budget */
+    virtual std::size_t footprint() const;
+
 private:
     /** \private */
     struct ThemeSubdirectory
@@ -56,7 +56,8 @@ Legacy::Legacy(const AppID::AppName& appname, const std::shared_ptr<Registry::Im
     : Base(registry)
     , _appname(appname)
 {
-    std::tie(_basedir, _keyfile, desktopPath_) = keyfileForApp(appname);
+    std::shared_ptr<GKeyFile> keyfile;
+    std::tie(_basedir, keyfile, desktopPath_) = keyfileForApp(appname);
 
     std::string rootDir = "";
     auto rootenv = g_getenv("UBUNTU_APP_LAUNCH_LEGACY_ROOT");
@@ -68,18 +69,33 @@ Legacy::Legacy(const AppID::AppName& appname, const std::shared_ptr<Registry::Im
 
     auto flags = app_info::DesktopFlags::ALLOW_NO_DISPLAY;
 
-    if (!g_key_file_has_key(_keyfile.get(), "Desktop Entry", "X-Ubuntu-Touch", nullptr))
+    if (!g_key_file_has_key(keyfile.get(), "Desktop Entry", "X-Ubuntu-Touch", nullptr))
     {
         flags |= app_info::DesktopFlags::XMIR_DEFAULT;
     }
 
-    appinfo_ = std::make_shared<app_info::Desktop>(appId(), _keyfile, _basedir, rootDir, flags, registry_);
+    appinfo_ = std::make_shared<app_info::Desktop>(appId(), keyfile, _basedir, rootDir, flags, registry_);
 
-    if (!_keyfile)
+    if (!keyfile)
     {
         throw std::runtime_error{"Unable to find keyfile for legacy application: " + appname.value()};
     }
 
+    /* Grab the launch only keys now so that we don't need to hold
+       the keyfile for the life of the object */
+    auto path = unique_gchar(g_key_file_get_string(keyfile.get(), "Desktop Entry", "Path", nullptr));
+    if (path)
+    {
+        workingDir_ = path.get();
+    }
+
+    auto apparmor =
+        unique_gchar(g_key_file_get_string(keyfile.get(), "Desktop Entry", "X-Ubuntu-AppArmor-Profile", nullptr));
+    if (apparmor)
+    {
+        apparmorProfile_ = apparmor.get();
+    }
+
     if (std::equal(snappyDesktopPath.begin(), snappyDesktopPath.end(), _basedir.begin()))
     {
         throw std::runtime_error{"Looking like a legacy app, but should be a Snap: " + appname.value()};
@@ -152,6 +168,7 @@ std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::stri
     info();
 
     retval.emplace_back(std::make_pair("APP_XMIR_ENABLE", appinfo_->xMirEnable().value() ? "1" : "0"));
+    retval.emplace_back(std::make_pair("APP_URIS_FILE", appinfo_->urisFile().value() ? "1" : "0"));
     auto execline = appinfo_->execLine().value();
 
     auto snappath = getenv("SNAP");
@@ -186,18 +203,15 @@ std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::stri
     retval.emplace_back(std::make_pair("APP_EXEC", execline));
 
     /* Honor the 'Path' key if it is in the desktop file */
-    if (g_key_file_has_key(_keyfile.get(), "Desktop Entry", "Path", nullptr))
+    if (!workingDir_.empty())
     {
-        auto path = unique_gchar(g_key_file_get_string(_keyfile.get(), "Desktop Entry", "Path", nullptr));
-        retval.emplace_back(std::make_pair("APP_DIR", path.get()));
+        retval.emplace_back(std::make_pair("APP_DIR", workingDir_));
     }
 
     /* If they've asked for an Apparmor profile, let's use it! */
-    auto apparmor =
-        unique_gchar(g_key_file_get_string(_keyfile.get(), "Desktop Entry", "X-Ubuntu-AppArmor-Profile", nullptr));
-    if (apparmor)
+    if (!apparmorProfile_.empty())
     {
-        retval.emplace_back(std::make_pair("APP_EXEC_POLICY", apparmor.get()));
+        retval.emplace_back(std::make_pair("APP_EXEC_POLICY", apparmorProfile_));
 
         retval.splice(retval.end(), confinedEnv(_appname, "/usr/share"));
     }
@@ -67,9 +67,10 @@ public:
 private:
     AppID::AppName _appname;
     std::string _basedir;
-    std::shared_ptr<GKeyFile> _keyfile;
     std::shared_ptr<app_info::Desktop> appinfo_;
     std::string desktopPath_;
+    std::string workingDir_;
+    std::string apparmorProfile_;
     std::regex instanceRegex_;
 
     std::list<std::pair<std::string, std::string>> launchEnv(const std::string& instance);
@@ -46,28 +46,25 @@ Libertine::Libertine(const AppID::Package& container,
         _container_path = gcontainer_path.get();
     }
 
-    if (!_keyfile)
-    {
-        auto system_app_path = unique_gchar(g_build_filename(_container_path.c_str(), "usr", "share", nullptr));
-        _basedir = system_app_path.get();
+    auto system_app_path = unique_gchar(g_build_filename(_container_path.c_str(), "usr", "share", nullptr));
+    _basedir = system_app_path.get();
 
-        _keyfile = findDesktopFile(_basedir, "applications", appname.value() + ".desktop");
-    }
+    auto keyfile = findDesktopFile(_basedir, "applications", appname.value() + ".desktop");
 
-    if (!_keyfile)
+    if (!keyfile)
     {
         auto container_home_path = unique_gchar(libertine_container_home_path(container.value().c_str()));
         auto local_app_path = unique_gchar(g_build_filename(container_home_path.get(), ".local", "share", nullptr));
         _basedir = local_app_path.get();
 
-        _keyfile = findDesktopFile(_basedir, "applications", appname.value() + ".desktop");
+        keyfile = findDesktopFile(_basedir, "applications", appname.value() + ".desktop");
     }
 
-    if (!_keyfile)
+    if (!keyfile)
         throw std::runtime_error{"Unable to find a keyfile for application '" + appname.value() + "' in container '" +
                                  container.value() + "'"};
 
-    appinfo_ = std::make_shared<app_info::Desktop>(appId(), _keyfile, _basedir, _container_path,
+    appinfo_ = std::make_shared<app_info::Desktop>(appId(), keyfile, _basedir, _container_path,
                                                    app_info::DesktopFlags::XMIR_DEFAULT, registry_);
 
     g_debug("Application Libertine object for container '%s' app '%s'", container.value().c_str(),
@@ -157,6 +154,7 @@ std::list<std::pair<std::string, std::string>> Libertine::launchEnv()
     info();
 
     retval.emplace_back(std::make_pair("APP_XMIR_ENABLE", appinfo_->xMirEnable().value() ? "1" : "0"));
+    retval.emplace_back(std::make_pair("APP_URIS_FILE", appinfo_->urisFile().value() ? "1" : "0"));
 
     /* The container is our confinement */
     retval.emplace_back(std::make_pair("APP_EXEC_POLICY", "unconfined"));
@@ -295,6 +295,7 @@ std::list<std::pair<std::string, std::string>> Snap::launchEnv()
     std::list<std::pair<std::string, std::string>> retval;
 
     retval.emplace_back(std::make_pair("APP_XMIR_ENABLE", info_->xMirEnable().value() ? "1" : "0"));
+    retval.emplace_back(std::make_pair("APP_URIS_FILE", info_->urisFile().value() ? "1" : "0"));
     if (info_->xMirEnable() && getenv("SNAP") == nullptr)
     {
         /* If we're setting up XMir we also need the other helpers
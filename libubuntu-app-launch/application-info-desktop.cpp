@@ -404,7 +404,13 @@ Desktop::Desktop(const AppID& appid,
           boolFromKeyfile<XMirEnable>(keyfile, "X-Ubuntu-XMir-Enable", (flags & DesktopFlags::XMIR_DEFAULT).any()))
     , _exec(stringFromKeyfile<Exec>(keyfile, "Exec"))
     , _singleInstance(boolFromKeyfile<SingleInstance>(keyfile, "X-Ubuntu-Single-Instance", false))
+    , _hibernate(boolFromKeyfile<Hibernate>(keyfile, "X-Ubuntu-Hibernate", false))
+    , _urisFile(boolFromKeyfile<UrisFile>(keyfile, "X-Ubuntu-URIs-File", false))
 {
+    /* Everything has been parsed out of the key file, and the
+       application objects only keep what they need for launch, so
+       this is the last reference to it */
+    _keyfile.reset();
 }
 
 }  // namespace app_info
@@ -120,6 +120,20 @@ public:
         return _singleInstance;
     }
 
+    struct HibernateTag;
+    typedef TypeTagger<HibernateTag, bool> Hibernate;
+    virtual Hibernate hibernate()
+    {
+        return _hibernate;
+    }
+
+    struct UrisFileTag;
+    typedef TypeTagger<UrisFileTag, bool> UrisFile;
+    virtual UrisFile urisFile()
+    {
+        return _urisFile;
+    }
+
 protected:
     std::shared_ptr<GKeyFile> _keyfile;
     std::string _basePath;
@@ -141,6 +155,8 @@ protected:
     XMirEnable _xMirEnable;
     Exec _exec;
     SingleInstance _singleInstance;
+    Hibernate _hibernate;
+    UrisFile _urisFile;
 };
 
 }  // namespace AppInfo
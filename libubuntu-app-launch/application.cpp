@@ -435,6 +435,17 @@ bool Application::operator!=(const Application& b) const
     return appId() != b.appId();
 }
 
+bool Application::Instance::hibernate(const std::function<void(bool)>& finished)
+{
+    auto base = dynamic_cast<jobs::instance::Base*>(this);
+    if (base == nullptr)
+    {
+        return false;
+    }
+
+    return base->hibernate(finished);
+}
+
 bool Application::Instance::operator==(const Application::Instance& b) const
 {
     auto ja = dynamic_cast<const jobs::instance::Base*>(this);
@@ -17,6 +17,7 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
+#include <functional>
 #include <list>
 #include <memory>
 #include <sys/types.h>
@@ -253,6 +254,18 @@ public:
         /** Stop, or send SIGTERM, to the PIDs in this Application::Instance, if
             the PIDs do not respond to the SIGTERM they will be SIGKILL'd */
         virtual void stop() = 0;
+        /** Save the state of the Application::Instance to disk and stop it, the
+            next launch of the application restores it instead of starting fresh.
+            The restored instance comes back paused so resume it as usual.
+
+            \note Only works for applications that set X-Ubuntu-Hibernate in
+                  their desktop file and when a checkpointer is available.
+
+            \param finished Called on the registry's thread with whether the
+                            instance was saved and stopped
+            \returns Whether saving the instance was started
+        */
+        bool hibernate(const std::function<void(bool)>& finished = nullptr);
         /** Signal the shell to focus the Application::Instance */
         virtual void focus() = 0;
 
@@ -267,6 +280,11 @@ public:
 
     /** Start an application, optionally with URLs to pass to it.
 
+        Applications that set X-Ubuntu-URIs-File in their desktop file
+        get large sets of URLs written one per line into a file instead
+        of on their command line, with the path to that file in their
+        UBUNTU_APP_LAUNCH_URIS_FILE environment variable.
+
         \param urls A list of URLs to pass to the application command line
     */
     virtual std::shared_ptr<Instance> launch(const std::vector<URL>& urls = {}) = 0;
@@ -0,0 +1,210 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "checkpointer-base.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <unity/util/GlibMemory.h>
+
+using namespace unity::util;
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace checkpointer
+{
+
+Base::Base()
+{
+    auto envdir = getenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR");
+    if (envdir != nullptr)
+    {
+        basedir_ = envdir;
+    }
+    else
+    {
+        auto cdir = unique_gchar(
+            g_build_filename(g_get_user_cache_dir(), "ubuntu-app-launch", "checkpoints", nullptr));
+        basedir_ = cdir.get();
+    }
+}
+
+/** Directory for the image of an application */
+std::string Base::imageDir(const AppID& appid) const
+{
+    auto cdir = unique_gchar(g_build_filename(basedir_.c_str(), std::string(appid).c_str(), nullptr));
+    return cdir.get();
+}
+
+/** Directory for an image while a unit is restoring from it. AppIDs
+    can't start with a dot so this won't collide with an image. */
+std::string Base::restoreDir(const std::string& unitname) const
+{
+    auto cdir = unique_gchar(g_build_filename(basedir_.c_str(), ".restore", unitname.c_str(), nullptr));
+    return cdir.get();
+}
+
+/** Check to see if there is an image waiting for an application */
+bool Base::hasImage(const AppID& appid)
+{
+    return g_file_test(imageDir(appid).c_str(), G_FILE_TEST_IS_DIR) == TRUE;
+}
+
+/** Saves the process tree under @pid as the image for @appid, replacing
+    any older one. We dump into a temporary directory and only move it
+    into place when the dump worked so that a failed dump never leaves
+    half of an image around.
+
+    \param appid Application the processes belong to
+    \param pid Root of the process tree, it should be paused
+    \param cancel Cancellable for the dump
+    \param finished Called with whether the image was saved
+*/
+void Base::checkpoint(const AppID& appid,
+                      pid_t pid,
+                      GCancellable* cancel,
+                      const std::function<void(bool)>& finished)
+{
+    auto imagedir = imageDir(appid);
+    auto tmpdir = imagedir + ".tmp";
+
+    removeTree(tmpdir);
+    if (g_mkdir_with_parents(tmpdir.c_str(), 0700) != 0)
+    {
+        g_warning("Unable to create checkpoint directory: %s", tmpdir.c_str());
+        finished(false);
+        return;
+    }
+
+    g_debug("Checkpointing PID %d for '%s' to: %s", pid, std::string(appid).c_str(), tmpdir.c_str());
+    auto appidstr = std::string(appid);
+    dump(pid, tmpdir, cancel, [appidstr, imagedir, tmpdir, finished](bool dumped) {
+        if (!dumped)
+        {
+            g_warning("Unable to checkpoint '%s'", appidstr.c_str());
+            removeTree(tmpdir);
+            finished(false);
+            return;
+        }
+
+        removeTree(imagedir);
+        if (g_rename(tmpdir.c_str(), imagedir.c_str()) != 0)
+        {
+            g_warning("Unable to move checkpoint into place: %s", imagedir.c_str());
+            removeTree(tmpdir);
+            finished(false);
+            return;
+        }
+
+        finished(true);
+    });
+}
+
+/** If there is an image for @appid it is handed over to @unitname and
+    we return the command line that restores it. Empty if there is nothing
+    to restore.
+
+    \param appid Application being launched
+    \param unitname Unit that will run the restore
+*/
+std::vector<std::string> Base::restore(const AppID& appid, const std::string& unitname)
+{
+    if (!hasImage(appid))
+    {
+        return {};
+    }
+
+    auto imagedir = imageDir(appid);
+    auto restoredir = restoreDir(unitname);
+
+    removeTree(restoredir);
+    auto parent = unique_gchar(g_path_get_dirname(restoredir.c_str()));
+    g_mkdir_with_parents(parent.get(), 0700);
+
+    if (g_rename(imagedir.c_str(), restoredir.c_str()) != 0)
+    {
+        g_warning("Unable to claim checkpoint '%s' for unit '%s'", imagedir.c_str(), unitname.c_str());
+        return {};
+    }
+
+    g_debug("Restoring '%s' from checkpoint", std::string(appid).c_str());
+    return restoreCommand(restoredir);
+}
+
+/** Give an image claimed by restore() back to @appid, used when the
+    unit that would have restored it never got created. A newer image
+    wins over the one we're giving back. */
+void Base::unclaim(const AppID& appid, const std::string& unitname)
+{
+    auto restoredir = restoreDir(unitname);
+    if (!g_file_test(restoredir.c_str(), G_FILE_TEST_IS_DIR))
+    {
+        return;
+    }
+
+    if (hasImage(appid) || g_rename(restoredir.c_str(), imageDir(appid).c_str()) != 0)
+    {
+        removeTree(restoredir);
+        return;
+    }
+
+    g_debug("Unit '%s' not started, keeping checkpoint for '%s'", unitname.c_str(), std::string(appid).c_str());
+}
+
+/** Clean up the image used by a unit once it is gone */
+void Base::restoreFinished(const std::string& unitname)
+{
+    removeTree(restoreDir(unitname));
+}
+
+/** Throw away the image for an application, it is stale */
+void Base::discard(const AppID& appid)
+{
+    removeTree(imageDir(appid));
+}
+
+/** Remove a file or a directory and everything in it */
+void Base::removeTree(const std::string& path)
+{
+    if (g_file_test(path.c_str(), G_FILE_TEST_IS_SYMLINK) || !g_file_test(path.c_str(), G_FILE_TEST_IS_DIR))
+    {
+        g_unlink(path.c_str());
+        return;
+    }
+
+    auto dir = g_dir_open(path.c_str(), 0, nullptr);
+    if (dir != nullptr)
+    {
+        const gchar* name;
+        while ((name = g_dir_read_name(dir)) != nullptr)
+        {
+            auto child = unique_gchar(g_build_filename(path.c_str(), name, nullptr));
+            removeTree(child.get());
+        }
+        g_dir_close(dir);
+    }
+
+    g_rmdir(path.c_str());
+}
+
+}  // namespace checkpointer
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "appid.h"
+
+#include <functional>
+#include <gio/gio.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace checkpointer
+{
+
+/** Saves the process tree of an application to disk so that it can be
+    brought back later instead of starting it cold. There is one image
+    per AppID, stored in the user's cache directory, and an image is only
+    restored once. Subclasses provide the tool that does the real work. */
+class Base
+{
+public:
+    Base();
+    virtual ~Base() = default;
+
+    void checkpoint(const AppID& appid,
+                    pid_t pid,
+                    GCancellable* cancel,
+                    const std::function<void(bool)>& finished);
+    bool hasImage(const AppID& appid);
+    std::vector<std::string> restore(const AppID& appid, const std::string& unitname);
+    void unclaim(const AppID& appid, const std::string& unitname);
+    void restoreFinished(const std::string& unitname);
+    void discard(const AppID& appid);
+
+protected:
+    /** Write the process tree under @pid into @imagedir without blocking
+        and call @finished with whether it worked. The processes are paused
+        when this is called and should be left that way. */
+    virtual void dump(pid_t pid,
+                      const std::string& imagedir,
+                      GCancellable* cancel,
+                      const std::function<void(bool)>& finished) = 0;
+    /** Command line that restores the image in @imagedir. It is run as
+        the application's process so it shouldn't detach. */
+    virtual std::vector<std::string> restoreCommand(const std::string& imagedir) = 0;
+
+    std::string imageDir(const AppID& appid) const;
+    std::string restoreDir(const std::string& unitname) const;
+
+private:
+    /** Directory that all the images live in */
+    std::string basedir_;
+
+    static void removeTree(const std::string& path);
+};
+
+}  // namespace checkpointer
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "checkpointer-criu.h"
+
+#include <gio/gio.h>
+#include <memory>
+#include <unity/util/GlibMemory.h>
+
+using namespace unity::util;
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace checkpointer
+{
+
+Criu::Criu()
+    : Base()
+{
+    auto envcriu = getenv("UBUNTU_APP_LAUNCH_CRIU");
+    if (envcriu != nullptr)
+    {
+        criu_ = envcriu;
+    }
+    else
+    {
+        criu_ = "criu";
+    }
+}
+
+/** Data to track a criu dump while it runs */
+struct DumpData
+{
+    pid_t pid;
+    std::string criu;
+    std::function<void(bool)> finished;
+};
+
+/** Runs criu to dump the tree, we leave the processes stopped so that
+    they can be stopped cleanly with their unit afterwards. Dumping a big
+    application takes a while so we don't wait on it, @finished is called
+    from the main loop of the thread that called us. */
+void Criu::dump(pid_t pid, const std::string& imagedir, GCancellable* cancel, const std::function<void(bool)>& finished)
+{
+    auto spid = std::to_string(pid);
+    std::vector<const gchar*> args{criu_.c_str(),    "dump",          "--tree",          spid.c_str(),
+                                   "--images-dir",   imagedir.c_str(), "--leave-stopped", "--file-locks",
+                                   "--tcp-established", nullptr};
+
+    GError* error{nullptr};
+    auto subprocess = g_subprocess_newv(args.data(),                                                 /* args */
+                                        GSubprocessFlags(G_SUBPROCESS_FLAGS_STDOUT_SILENCE |         /* flags */
+                                                         G_SUBPROCESS_FLAGS_STDERR_PIPE), &error); /* error */
+
+    if (error != nullptr)
+    {
+        g_warning("Unable to run '%s' to dump PID %d: %s", criu_.c_str(), pid, error->message);
+        g_error_free(error);
+        finished(false);
+        return;
+    }
+
+    g_subprocess_communicate_utf8_async(
+        subprocess, /* subprocess */
+        nullptr,    /* stdin */
+        cancel,     /* cancellable */
+        [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+            auto data = std::unique_ptr<DumpData>(static_cast<DumpData*>(user_data));
+            auto subprocess = G_SUBPROCESS(obj);
+            GError* error{nullptr};
+            gchar* cerr{nullptr};
+
+            g_subprocess_communicate_utf8_finish(subprocess, res, nullptr, &cerr, &error);
+            auto errout = unique_gchar(cerr);
+
+            if (error == nullptr)
+            {
+                g_spawn_check_exit_status(g_subprocess_get_status(subprocess), &error);
+            }
+
+            g_object_unref(subprocess);
+
+            if (error != nullptr)
+            {
+                if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                {
+                    g_warning("Unable to dump PID %d with '%s': %s: %s", data->pid, data->criu.c_str(),
+                              error->message, errout ? errout.get() : "");
+                }
+                g_error_free(error);
+                data->finished(false);
+                return;
+            }
+
+            data->finished(true);
+        },
+        new DumpData{pid, criu_, finished});
+}
+
+std::vector<std::string> Criu::restoreCommand(const std::string& imagedir)
+{
+    return {criu_, "restore", "--images-dir", imagedir, "--file-locks", "--tcp-established"};
+}
+
+}  // namespace checkpointer
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "checkpointer-base.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace checkpointer
+{
+
+/** Checkpointer that uses CRIU to dump and restore process trees */
+class Criu : public Base
+{
+public:
+    Criu();
+    virtual ~Criu() = default;
+
+protected:
+    void dump(pid_t pid,
+              const std::string& imagedir,
+              GCancellable* cancel,
+              const std::function<void(bool)>& finished) override;
+    std::vector<std::string> restoreCommand(const std::string& imagedir) override;
+
+private:
+    /** Path to the criu binary */
+    std::string criu_;
+};
+
+}  // namespace checkpointer
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -26,7 +26,19 @@ using namespace unity::util;
 namespace GLib
 {
 
-ContextThread::ContextThread(const std::function<void()>& beforeLoop, const std::function<void()>& afterLoop)
+/** Builds a thread with its own context and mainloop, unless @context
+    is set. In that case no thread is created and all of the work is
+    done on the caller's context. The thread creating us is expected to
+    be the one iterating it, work requested on that thread is done
+    immediately without switching threads.
+
+    \param beforeLoop Function to run on the context before starting
+    \param afterLoop Function to run when the context is shutting down
+    \param context Caller's context to use instead of creating a thread
+*/
+ContextThread::ContextThread(const std::function<void()>& beforeLoop,
+                             const std::function<void()>& afterLoop,
+                             const std::shared_ptr<GMainContext>& context)
 {
     _cancel = std::shared_ptr<GCancellable>(g_cancellable_new(), [](GCancellable* cancel) {
         if (cancel != nullptr)
@@ -43,6 +55,18 @@ ContextThread::ContextThread(const std::function<void()>& beforeLoop, const std:
     afterLoop_ = afterLoop;
     afterFlag_ = std::make_shared<std::once_flag>();
 
+    if (context)
+    {
+        /* No thread, no loop, the caller is running the context */
+        _context = context;
+        _owner = std::this_thread::get_id();
+        executeOnThread<bool>([&beforeLoop]() {
+            beforeLoop();
+            return true;
+        });
+        return;
+    }
+
     _thread = std::thread([&context_promise, &beforeLoop, this]() {
         /* Build up the context and loop for the async events and a place
            for GDBus to send its events back to */
@@ -107,6 +131,11 @@ void ContextThread::quit()
             _thread.detach();
         }
     }
+    else if (!_loop)
+    {
+        /* Running on the caller's context, nothing to wait for */
+        std::call_once(*afterFlag_, afterLoop_);
+    }
 }
 
 bool ContextThread::isCancelled()
@@ -129,7 +158,16 @@ guint ContextThread::simpleSource(std::function<GSource*()> srcBuilder, std::fun
     /* Copy the work so that we can reuse it */
     /* Lifecycle is handled with the source pointer when we attach
        it to the context. */
-    auto heapWork = new std::function<void()>(work);
+    /* The context can outlive us if it belongs to the caller, so we
+       drop any work that is still queued once we've been cancelled.
+       Anyone waiting on it gets an error when it is freed. */
+    auto cancel = _cancel;
+    auto heapWork = new std::function<void()>([cancel, work]() {
+        if (!g_cancellable_is_cancelled(cancel.get()))
+        {
+            work();
+        }
+    });
 
     auto source = unique_glib(srcBuilder());
     g_source_set_callback(source.get(),
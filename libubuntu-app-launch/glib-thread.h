@@ -21,6 +21,7 @@
 
 #include <future>
 #include <mutex>
+#include <stdexcept>
 #include <thread>
 
 #include <gio/gio.h>
@@ -38,8 +39,13 @@ class ContextThread
     std::function<void(void)> afterLoop_;
     std::shared_ptr<std::once_flag> afterFlag_;
 
+    /** Thread that iterates the caller's context, when we're using one */
+    std::thread::id _owner;
+
 public:
-    ContextThread(const std::function<void()>& beforeLoop = [] {}, const std::function<void()>& afterLoop = [] {});
+    ContextThread(const std::function<void()>& beforeLoop = [] {},
+                  const std::function<void()>& afterLoop = [] {},
+                  const std::shared_ptr<GMainContext>& context = {});
     ~ContextThread();
 
     void quit();
@@ -56,21 +62,45 @@ public:
             return work();
         }
 
-        std::promise<T> promise;
-        std::function<void()> magicFunc = [&promise, &work]() {
+        if (!_loop && (std::this_thread::get_id() == _owner || g_main_context_is_owner(_context.get())))
+        {
+            /* We're on the thread that iterates the caller's context, so
+               no one else is going to dispatch the work if we wait for it */
+            if (isCancelled())
+            {
+                throw std::runtime_error{"Unable to do work on a context that is shutting down"};
+            }
+            if (!g_main_context_acquire(_context.get()))
+            {
+                g_critical("Main context is owned by another thread, unable to do work on it");
+                throw std::runtime_error{"Unable to acquire the main context"};
+            }
+
+            ContextOwner owner{_context};
+            return work();
+        }
+
+        auto result = std::make_shared<PendingResult<T>>();
+        auto future = result->promise.get_future();
+        std::function<void()> magicFunc = [result, &work]() {
             try
             {
-                promise.set_value(work());
+                result->promise.set_value(work());
             }
             catch (...)
             {
-                promise.set_exception(std::current_exception());
+                result->promise.set_exception(std::current_exception());
             }
+            result->done = true;
         };
 
         executeOnThread(magicFunc);
 
-        auto future = promise.get_future();
+        /* Only the queued work holds the result now, if it gets dropped
+           the result is destroyed and we wake up with an error */
+        magicFunc = nullptr;
+        result.reset();
+
         future.wait();
         return future.get();
     }
@@ -93,5 +123,44 @@ public:
 
 private:
     guint simpleSource(std::function<GSource*()> srcBuilder, std::function<void()> work);
+
+    /** Result of work done for another thread. If the work is dropped
+        without running, because we're shutting down, the waiting
+        thread gets an exception instead of waiting forever. */
+    template <typename T>
+    struct PendingResult
+    {
+        std::promise<T> promise;
+        bool done{false};
+
+        ~PendingResult()
+        {
+            if (!done)
+            {
+                promise.set_exception(
+                    std::make_exception_ptr(std::runtime_error("Work dropped as the GLib thread is shutting down")));
+            }
+        }
+    };
+
+    /** Makes an acquired context the thread default for its lifetime
+        and releases it when done */
+    class ContextOwner
+    {
+        std::shared_ptr<GMainContext> context_;
+
+    public:
+        explicit ContextOwner(const std::shared_ptr<GMainContext>& context)
+            : context_(context)
+        {
+            g_main_context_push_thread_default(context_.get());
+        }
+
+        ~ContextOwner()
+        {
+            g_main_context_pop_thread_default(context_.get());
+            g_main_context_release(context_.get());
+        }
+    };
 };
 }
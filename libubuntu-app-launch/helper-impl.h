@@ -75,6 +75,8 @@ public:
 
     std::shared_ptr<Helper::Instance> launch(std::vector<Helper::URL> urls = {}) override;
     std::shared_ptr<Helper::Instance> launch(MirPromptSession* session, std::vector<Helper::URL> urls = {}) override;
+    std::shared_ptr<Helper::Instance> activate(std::vector<Helper::Endpoint> endpoints,
+                                               std::vector<Helper::URL> urls = {});
 
     std::shared_ptr<Helper::Instance> existingInstance(const std::string& instanceid);
 
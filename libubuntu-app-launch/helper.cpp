@@ -221,6 +221,22 @@ std::shared_ptr<Helper::Instance> Base::launch(std::vector<Helper::URL> urls)
                                   jobs::manager::launchMode::STANDARD, envfunc));
 }
 
+/** Sets up the helper to be started by systemd on first use of one
+    of the endpoints. */
+std::shared_ptr<Helper::Instance> Base::activate(std::vector<Helper::Endpoint> endpoints, std::vector<Helper::URL> urls)
+{
+    if (endpoints.empty())
+    {
+        throw std::runtime_error{"Activating helper '" + std::string(_appid) + "' without any endpoints"};
+    }
+
+    auto defaultenv = defaultEnv();
+    std::function<std::list<std::pair<std::string, std::string>>()> envfunc = [defaultenv]() { return defaultenv; };
+
+    return std::make_shared<BaseInstance>(
+        _type, registry_->jobs()->activate(_appid, _type.value(), genInstanceId(), appURL(urls), endpoints, envfunc));
+}
+
 class MirFDProxy
 {
 public:
@@ -434,6 +450,17 @@ bool Helper::operator!=(const Helper& b) const
     return ja->appId() != jb->appId() || ja->getType() != jb->getType();
 }
 
+std::shared_ptr<Helper::Instance> Helper::activate(std::vector<Endpoint> endpoints, std::vector<URL> urls)
+{
+    auto base = dynamic_cast<helper_impls::Base*>(this);
+    if (base == nullptr)
+    {
+        throw std::runtime_error{"Helper implementation doesn't support activation"};
+    }
+
+    return base->activate(endpoints, urls);
+}
+
 bool Helper::Instance::operator==(const Helper::Instance& b) const
 {
     auto ja = dynamic_cast<const helper_impls::BaseInstance*>(this);
@@ -18,6 +18,7 @@
  */
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <mir_toolkit/mir_prompt_session.h>
@@ -125,6 +126,31 @@ public:
         \param urls List of URLs to passed to the untrusted helper
     */
     virtual std::shared_ptr<Instance> launch(MirPromptSession* session, std::vector<URL> urls = {}) = 0;
+
+    /** Something that starts the helper when it is first used */
+    struct Endpoint
+    {
+        /** Kinds of endpoints */
+        enum class Kind
+        {
+            SOCKET,   /**< A stream socket on the filesystem */
+            DBUS_NAME /**< A well known name on the session bus */
+        };
+
+        Kind kind;           /**< What kind of endpoint this is */
+        std::string address; /**< Path of the socket or the D-Bus name */
+    };
+
+    /** Setup an instance of a helper that is only started when one of
+        its endpoints is used, instead of right away. The instance is
+        tracked like any other, but isn't running until it is used. It
+        can exit when idle and will be started again on the next use.
+        Stopping the instance removes the endpoints.
+
+        \param endpoints Sockets and D-Bus names that start the helper
+        \param urls List of URLs to passed to the untrusted helper
+    */
+    std::shared_ptr<Instance> activate(std::vector<Endpoint> endpoints, std::vector<URL> urls = {});
     /** Set the exec from a helper utility. This function should only
         be used inside a helper exec util.
 
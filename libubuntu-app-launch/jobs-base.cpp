@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <numeric>
 #include <unity/util/GObjectMemory.h>
@@ -26,6 +27,7 @@
 #include <unity/util/ResourcePtr.h>
 
 #include "application-impl-base.h"
+#include "application-info-desktop.h"
 #include "helper-impl.h"
 #include "jobs-base.h"
 #include "jobs-systemd.h"
@@ -46,7 +48,15 @@ namespace manager
 Base::Base(const std::shared_ptr<Registry::Impl>& registry)
     : registry_{registry}
     , allApplicationJobs_{"application-legacy", "application-snap"}
+    , restartPolicy_{false, 0, std::chrono::milliseconds{0}, std::chrono::milliseconds{0}, std::chrono::seconds{0}}
+    , lifecycleEvents_(0)
+    , instanceCaps_{0, {}}
 {
+    auto envcap = getenv("UBUNTU_APP_LAUNCH_INSTANCE_CAP");
+    if (envcap != nullptr)
+    {
+        instanceCaps_.applications = std::strtoul(envcap, nullptr, 10);
+    }
 }
 
 Base::~Base()
@@ -628,6 +638,766 @@ void Base::clearManager()
     manager_.reset();
 }
 
+/** Set the policy for restarting crashed applications. We start watching
+    for failures the first time it is set, after that a disabled policy
+    just ignores them. */
+void Base::setRestartPolicy(const Registry::RestartPolicy& policy)
+{
+    auto reg = getReg();
+
+    reg->thread.executeOnThread<bool>([this, policy]() {
+        restartPolicy_ = policy;
+        restarts_.clear();
+        return true;
+    });
+
+    if (!policy.enabled)
+    {
+        return;
+    }
+
+    std::call_once(flag_restartPolicy, [this]() {
+        jobFailed().connect([this](const std::string& job, const std::string& appid, const std::string& instanceid,
+                                   Registry::FailureType reason) { restartCrashed(job, appid, reason); });
+        jobStopped().connect([this](const std::string& job, const std::string& appid, const std::string& instanceid) {
+            pruneRestarts(job, appid);
+        });
+    });
+}
+
+/** Feeds application lifecycle events into the registry's usage ledger,
+    creating it if there isn't one. Pauses and resumes come from the
+    D-Bus signals so they're counted whichever process sent them. */
+void Base::trackUsage()
+{
+    std::call_once(flag_trackUsage, [this]() {
+        auto reg = getReg();
+        if (!reg->getUsageLedger())
+        {
+            reg->setUsageLedger(std::make_shared<UsageLedger>(reg));
+        }
+
+        usageTracking_ = subscribeLifecycle(
+            Registry::LifecycleFilter{{},
+                                      {},
+                                      Registry::LIFECYCLE_STARTED | Registry::LIFECYCLE_STOPPED |
+                                          Registry::LIFECYCLE_PAUSED | Registry::LIFECYCLE_RESUMED},
+            [this](const Registry::LifecycleChange& change) {
+                if (!change.job.empty() &&
+                    std::find(allApplicationJobs_.begin(), allApplicationJobs_.end(), change.job) ==
+                        allApplicationJobs_.end())
+                {
+                    return;
+                }
+
+                auto ledger = getReg()->getUsageLedger();
+                if (!ledger)
+                {
+                    return;
+                }
+
+                switch (change.event)
+                {
+                    case Registry::LIFECYCLE_STARTED:
+                        ledger->started(change.appid, change.instance);
+                        break;
+                    case Registry::LIFECYCLE_STOPPED:
+                        ledger->stopped(change.appid, change.instance);
+                        break;
+                    case Registry::LIFECYCLE_PAUSED:
+                        ledger->paused(change.appid, change.instance);
+                        break;
+                    case Registry::LIFECYCLE_RESUMED:
+                        ledger->resumed(change.appid, change.instance);
+                        break;
+                    default:
+                        break;
+                }
+            });
+    });
+}
+
+/** Subscribe to the lifecycle events that match @filter. Subscribers are
+    indexed by job and AppID so that an event only has to be checked against
+    the ones that could want it, and nothing is built for an event that no
+    one wants. The job signals are only connected once someone asks. */
+std::shared_ptr<Registry::LifecycleSubscription> Base::subscribeLifecycle(
+    const Registry::LifecycleFilter& filter, std::function<void(const Registry::LifecycleChange&)> callback)
+{
+    if (!callback)
+    {
+        throw std::runtime_error{"Lifecycle subscription requires a callback"};
+    }
+    if ((filter.events & Registry::LIFECYCLE_ALL) == 0)
+    {
+        throw std::runtime_error{"Lifecycle subscription for AppID '" + filter.appid + "' has no events"};
+    }
+
+    auto sub = std::make_shared<LifecycleSubscriber>();
+    sub->filter = filter;
+    sub->callback = callback;
+    sub->manager = shared_from_this();
+
+    {
+        std::lock_guard<std::mutex> guard(lifecycleLock_);
+
+        auto& index = lifecycleSubscribers_[filter.job];
+        if (filter.appid.empty() || filter.appid.find_first_of("*?") != std::string::npos)
+        {
+            index.patterns.push_back(sub);
+        }
+        else
+        {
+            index.byAppId[filter.appid].push_back(sub);
+        }
+
+        lifecycleEvents_ |= filter.events;
+    }
+
+    if ((filter.events & (Registry::LIFECYCLE_STARTED | Registry::LIFECYCLE_STOPPED | Registry::LIFECYCLE_FAILED)) != 0)
+    {
+        std::call_once(flag_lifecycleJobs, [this]() {
+            jobStarted().connect(
+                [this](const std::string& job, const std::string& appid, const std::string& instanceid) {
+                    dispatchLifecycle(Registry::LifecycleChange{Registry::LIFECYCLE_STARTED, job, appid, instanceid,
+                                                                Registry::FailureType::NONE,
+                                                                Registry::StopReason::STOPPED, {}});
+                });
+            jobStopped().connect(
+                [this](const std::string& job, const std::string& appid, const std::string& instanceid) {
+                    auto reason = instanceRetired(appid, instanceid) ? Registry::StopReason::RETIRED
+                                                                     : Registry::StopReason::STOPPED;
+                    dispatchLifecycle(Registry::LifecycleChange{Registry::LIFECYCLE_STOPPED, job, appid, instanceid,
+                                                                Registry::FailureType::NONE, reason, {}});
+                });
+            jobFailed().connect([this](const std::string& job, const std::string& appid,
+                                       const std::string& instanceid, Registry::FailureType reason) {
+                dispatchLifecycle(Registry::LifecycleChange{Registry::LIFECYCLE_FAILED, job, appid, instanceid, reason,
+                                                            Registry::StopReason::STOPPED, {}});
+            });
+
+            /* Other processes retiring instances tell us so the stops have the right reason */
+            auto reg = getReg();
+            reg->thread.executeOnThread<bool>([this, reg]() {
+                handle_lifecycleRetired = managedDBusSignalConnection(lifecycleRetiredSignal(), reg->_dbus);
+                return true;
+            });
+        });
+    }
+
+    if ((filter.events & (Registry::LIFECYCLE_PAUSED | Registry::LIFECYCLE_RESUMED)) != 0)
+    {
+        std::call_once(flag_lifecyclePauses, [this]() {
+            auto reg = getReg();
+            reg->thread.executeOnThread<bool>([this, reg]() {
+                handle_lifecyclePaused = managedDBusSignalConnection(
+                    lifecyclePauseSignal("ApplicationPaused", Registry::LIFECYCLE_PAUSED), reg->_dbus);
+                handle_lifecycleResumed = managedDBusSignalConnection(
+                    lifecyclePauseSignal("ApplicationResumed", Registry::LIFECYCLE_RESUMED), reg->_dbus);
+                return true;
+            });
+        });
+    }
+
+    return sub;
+}
+
+/** Check whether a lifecycle filter's AppID matches, it is either
+    empty, a pattern or the exact AppID */
+static bool lifecycleAppIdMatch(const std::string& filter, const std::string& appid)
+{
+    if (filter.empty())
+    {
+        return true;
+    }
+    if (filter.find_first_of("*?") == std::string::npos)
+    {
+        return filter == appid;
+    }
+    return g_pattern_match_simple(filter.c_str(), appid.c_str()) == TRUE;
+}
+
+/** Send an event to all the subscribers that want it. The subscribers are
+    collected under the lock and called without it so that they can
+    subscribe or unsubscribe from their callbacks. Pause and resume events
+    for instances we don't know the job of only go to subscribers for any
+    job. */
+void Base::dispatchLifecycle(const Registry::LifecycleChange& change)
+{
+    if ((lifecycleEvents_ & change.event) == 0)
+    {
+        return;
+    }
+
+    std::list<std::shared_ptr<LifecycleSubscriber>> matched;
+    /* Released after the lock as a subscriber going away takes it */
+    std::list<std::shared_ptr<LifecycleSubscriber>> held;
+    {
+        std::lock_guard<std::mutex> guard(lifecycleLock_);
+
+        auto collect = [&change, &matched, &held](std::list<std::weak_ptr<LifecycleSubscriber>>& subs) {
+            for (auto it = subs.begin(); it != subs.end();)
+            {
+                auto sub = it->lock();
+                if (!sub)
+                {
+                    it = subs.erase(it);
+                    continue;
+                }
+
+                if ((sub->filter.events & change.event) != 0 && lifecycleAppIdMatch(sub->filter.appid, change.appid))
+                {
+                    matched.push_back(sub);
+                }
+                held.push_back(sub);
+                ++it;
+            }
+        };
+
+        auto lookup = [this, &change, &collect](const std::string& job) {
+            auto index = lifecycleSubscribers_.find(job);
+            if (index == lifecycleSubscribers_.end())
+            {
+                return;
+            }
+
+            auto exact = index->second.byAppId.find(change.appid);
+            if (exact != index->second.byAppId.end())
+            {
+                collect(exact->second);
+                if (exact->second.empty())
+                {
+                    index->second.byAppId.erase(exact);
+                }
+            }
+
+            collect(index->second.patterns);
+        };
+
+        lookup(std::string{});
+        if (!change.job.empty())
+        {
+            lookup(change.job);
+        }
+    }
+
+    for (const auto& sub : matched)
+    {
+        sub->callback(change);
+    }
+}
+
+Base::LifecycleSubscriber::~LifecycleSubscriber()
+{
+    auto strong = manager.lock();
+    if (strong)
+    {
+        strong->lifecycleUnsubscribed();
+    }
+}
+
+/** A subscriber went away, drop the ones that are gone and only keep
+    the events the rest want so that the others get dropped early again. */
+void Base::lifecycleUnsubscribed()
+{
+    /* Released after the lock as a subscriber going away takes it */
+    std::list<std::shared_ptr<LifecycleSubscriber>> held;
+    std::lock_guard<std::mutex> guard(lifecycleLock_);
+
+    unsigned int events{0};
+    auto prune = [&events, &held](std::list<std::weak_ptr<LifecycleSubscriber>>& subs) {
+        for (auto it = subs.begin(); it != subs.end();)
+        {
+            auto sub = it->lock();
+            if (!sub)
+            {
+                it = subs.erase(it);
+                continue;
+            }
+
+            events |= sub->filter.events;
+            held.push_back(sub);
+            ++it;
+        }
+    };
+
+    for (auto index = lifecycleSubscribers_.begin(); index != lifecycleSubscribers_.end();)
+    {
+        auto& byAppId = index->second.byAppId;
+        for (auto app = byAppId.begin(); app != byAppId.end();)
+        {
+            prune(app->second);
+            app = app->second.empty() ? byAppId.erase(app) : std::next(app);
+        }
+        prune(index->second.patterns);
+
+        if (byAppId.empty() && index->second.patterns.empty())
+        {
+            index = lifecycleSubscribers_.erase(index);
+        }
+        else
+        {
+            ++index;
+        }
+    }
+
+    lifecycleEvents_ = events;
+}
+
+/** Finds which application job an instance is running under, pause and
+    resume signals only include the AppID and instance. Empty if we don't
+    know about the instance. */
+std::string Base::applicationJob(const std::string& appid, const std::string& instance)
+{
+    auto appId = AppID::parse(appid);
+
+    for (const auto& job : allApplicationJobs_)
+    {
+        for (const auto& inst : instances(appId, job))
+        {
+            if (inst->getInstanceId() == instance)
+            {
+                return job;
+            }
+        }
+    }
+
+    return {};
+}
+
+/** Subscribe to one of the pause signals for lifecycle subscribers. Only
+    the IDs and PIDs are pulled out of the signal, the application is not
+    looked up like it is for appPaused() and appResumed(). */
+guint Base::lifecyclePauseSignal(const std::string& signalname, Registry::LifecycleEvent event)
+{
+    struct LifecyclePauseData
+    {
+        std::weak_ptr<Registry::Impl> weakReg;
+        Registry::LifecycleEvent event;
+    };
+
+    auto reg = getReg();
+    auto data = new LifecyclePauseData{reg, event};
+
+    return g_dbus_connection_signal_subscribe(
+        reg->_dbus.get(),                /* bus */
+        nullptr,                         /* sender */
+        "com.canonical.UbuntuAppLaunch", /* interface */
+        signalname.c_str(),              /* signal */
+        "/",                             /* path */
+        nullptr,                         /* arg0 */
+        G_DBUS_SIGNAL_FLAGS_NONE,
+        [](GDBusConnection*, const gchar*, const gchar*, const gchar*, const gchar*, GVariant* params,
+           gpointer user_data) -> void {
+            auto data = reinterpret_cast<LifecyclePauseData*>(user_data);
+            auto reg = data->weakReg.lock();
+
+            if (!reg)
+            {
+                g_warning("Registry object invalid!");
+                return;
+            }
+
+            if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(ssat)")))
+            {
+                g_warning("Lifecycle pause signal with unexpected parameters: %s",
+                          g_variant_get_type_string(params));
+                return;
+            }
+
+            const gchar* cappid = nullptr;
+            const gchar* cinstid = nullptr;
+            GVariantIter* vpids = nullptr;
+            g_variant_get(params, "(&s&sat)", &cappid, &cinstid, &vpids);
+
+            std::vector<pid_t> pids;
+            guint64 pid;
+            while (g_variant_iter_loop(vpids, "t", &pid))
+            {
+                pids.emplace_back(pid);
+            }
+            g_variant_iter_free(vpids);
+
+            auto manager = std::dynamic_pointer_cast<Base>(reg->jobs());
+            if ((manager->lifecycleEvents_ & data->event) == 0)
+            {
+                return;
+            }
+
+            auto job = manager->applicationJob(cappid, cinstid);
+            manager->dispatchLifecycle(Registry::LifecycleChange{data->event, job, cappid, cinstid,
+                                                                 Registry::FailureType::NONE,
+                                                                 Registry::StopReason::STOPPED, pids});
+        },
+        data, /* user data */
+        [](gpointer user_data) {
+            auto data = reinterpret_cast<LifecyclePauseData*>(user_data);
+            delete data;
+        }); /* user data destroy */
+}
+
+/** Set the caps on the number of instances of each job. */
+void Base::setInstanceCaps(const Registry::InstanceCaps& caps)
+{
+    {
+        std::lock_guard<std::mutex> guard(instanceLock_);
+        instanceCaps_ = caps;
+    }
+
+    trackInstances();
+}
+
+/** Subscribe to the signal sent when an instance is retired so that its
+    stop is reported as RETIRED here too. We already know about the ones
+    we retire ourselves. */
+guint Base::lifecycleRetiredSignal()
+{
+    auto reg = getReg();
+    auto data = new upstartEventData{reg};
+
+    return g_dbus_connection_signal_subscribe(
+        reg->_dbus.get(),                /* bus */
+        nullptr,                         /* sender */
+        "com.canonical.UbuntuAppLaunch", /* interface */
+        "ApplicationRetired",            /* signal */
+        "/",                             /* path */
+        nullptr,                         /* arg0 */
+        G_DBUS_SIGNAL_FLAGS_NONE,
+        [](GDBusConnection* con, const gchar* sender, const gchar*, const gchar*, const gchar*, GVariant* params,
+           gpointer user_data) -> void {
+            auto data = reinterpret_cast<upstartEventData*>(user_data);
+            auto reg = data->weakReg.lock();
+
+            if (!reg)
+            {
+                g_warning("Registry object invalid!");
+                return;
+            }
+
+            if (g_strcmp0(sender, g_dbus_connection_get_unique_name(con)) == 0)
+            {
+                return;
+            }
+
+            if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(ss)")))
+            {
+                g_warning("Retired signal with unexpected parameters: %s", g_variant_get_type_string(params));
+                return;
+            }
+
+            const gchar* cappid = nullptr;
+            const gchar* cinstid = nullptr;
+            g_variant_get(params, "(&s&s)", &cappid, &cinstid);
+
+            auto manager = std::dynamic_pointer_cast<Base>(reg->jobs());
+            std::lock_guard<std::mutex> guard(manager->instanceLock_);
+            manager->retiring_.insert(std::make_pair(std::string{cappid}, std::string{cinstid}));
+        },
+        data,
+        [](gpointer user_data) {
+            auto data = reinterpret_cast<upstartEventData*>(user_data);
+            delete data;
+        });
+}
+
+/** Start tracking which instances are paused, and when they were last
+    resumed, so that we know which ones to retire. Only done once there
+    is a cap to enforce. */
+void Base::trackInstances()
+{
+    {
+        std::lock_guard<std::mutex> guard(instanceLock_);
+        if (instanceCaps_.applications == 0 && instanceCaps_.appids.empty())
+        {
+            return;
+        }
+    }
+
+    std::call_once(flag_trackInstances, [this]() {
+        instanceTracking_ = subscribeLifecycle(
+            Registry::LifecycleFilter{{},
+                                      {},
+                                      Registry::LIFECYCLE_STARTED | Registry::LIFECYCLE_STOPPED |
+                                          Registry::LIFECYCLE_PAUSED | Registry::LIFECYCLE_RESUMED},
+            [this](const Registry::LifecycleChange& change) { instanceChanged(change); });
+    });
+}
+
+/** The cap for a job, an AppID override wins over the cap for all
+    applications. Only applications are capped. Zero means there is
+    no cap. Expects the instance lock held. */
+unsigned int Base::instanceCap(const std::string& appid, const std::string& job)
+{
+    if (std::find(allApplicationJobs_.begin(), allApplicationJobs_.end(), job) == allApplicationJobs_.end())
+    {
+        return 0;
+    }
+
+    auto appcap = instanceCaps_.appids.find(appid);
+    if (appcap != instanceCaps_.appids.end())
+    {
+        return appcap->second;
+    }
+
+    return instanceCaps_.applications;
+}
+
+/** Keeps track of whether instances are paused and when they were last
+    in the foreground */
+void Base::instanceChanged(const Registry::LifecycleChange& change)
+{
+    std::lock_guard<std::mutex> guard(instanceLock_);
+    auto key = std::make_pair(change.appid, change.instance);
+
+    switch (change.event)
+    {
+        case Registry::LIFECYCLE_STARTED:
+        case Registry::LIFECYCLE_RESUMED:
+            instanceStates_[key] = InstanceState{false, std::chrono::steady_clock::now()};
+            break;
+        case Registry::LIFECYCLE_PAUSED:
+            /* One we haven't seen resumed sorts as the oldest */
+            instanceStates_[key].paused = true;
+            break;
+        case Registry::LIFECYCLE_STOPPED:
+            /* Failed instances are stopped as well */
+            instanceStates_.erase(key);
+            break;
+        default:
+            break;
+    }
+}
+
+/** Checks if a stopped instance was one we retired, and forgets about it */
+bool Base::instanceRetired(const std::string& appid, const std::string& instance)
+{
+    std::lock_guard<std::mutex> guard(instanceLock_);
+    return retiring_.erase(std::make_pair(appid, instance)) != 0;
+}
+
+/** Called before a new instance of a job is started. If that would put
+    the job over its cap we stop the paused instances that were resumed
+    the longest time ago. The stops are done asynchronously so that the
+    launch isn't held up by them. If there aren't enough paused instances
+    we start it anyway, we never stop one that is in use. */
+void Base::retireInstances(const AppID& appId, const std::string& job)
+{
+    std::string sappid{appId};
+
+    {
+        std::lock_guard<std::mutex> guard(instanceLock_);
+        if (instanceCap(sappid, job) == 0)
+        {
+            return;
+        }
+    }
+
+    auto running = instances(appId, job);
+
+    std::vector<std::pair<std::chrono::steady_clock::time_point, std::string>> retire;
+    {
+        std::lock_guard<std::mutex> guard(instanceLock_);
+        auto cap = instanceCap(sappid, job);
+        std::size_t count{0};
+
+        for (const auto& instance : running)
+        {
+            auto key = std::make_pair(sappid, instance->getInstanceId());
+            if (retiring_.find(key) != retiring_.end())
+            {
+                continue;
+            }
+            count++;
+
+            auto state = instanceStates_.find(key);
+            if (state != instanceStates_.end() && state->second.paused)
+            {
+                retire.emplace_back(state->second.lastResumed, key.second);
+            }
+        }
+
+        if (count < cap)
+        {
+            return;
+        }
+
+        std::size_t excess = count + 1 - cap;
+        if (retire.size() < excess)
+        {
+            g_warning("AppID '%s' is over its cap of %d instances, but only %d are paused", sappid.c_str(), int(cap),
+                      int(retire.size()));
+        }
+
+        std::stable_sort(retire.begin(), retire.end(),
+                         [](const std::pair<std::chrono::steady_clock::time_point, std::string>& a,
+                            const std::pair<std::chrono::steady_clock::time_point, std::string>& b) {
+                             return a.first < b.first;
+                         });
+        retire.resize(std::min(excess, retire.size()));
+
+        for (const auto& victim : retire)
+        {
+            retiring_.insert(std::make_pair(sappid, victim.second));
+        }
+    }
+
+    auto reg = getReg();
+    std::weak_ptr<Registry::Impl> weakReg = reg;
+
+    for (const auto& victim : retire)
+    {
+        auto instanceid = victim.second;
+        g_debug("Retiring instance '%s' of '%s'", instanceid.c_str(), sappid.c_str());
+
+        reg->thread.executeOnThread([weakReg, appId, job, instanceid] {
+            auto reg = weakReg.lock();
+            if (!reg)
+            {
+                return;
+            }
+
+            auto manager = std::dynamic_pointer_cast<Base>(reg->jobs());
+
+            try
+            {
+                manager->emitRetired(appId, instanceid);
+                manager->retireInstance(appId, job, instanceid);
+            }
+            catch (std::runtime_error& e)
+            {
+                g_warning("Unable to retire instance '%s' of '%s': %s", instanceid.c_str(),
+                          std::string(appId).c_str(), e.what());
+
+                std::lock_guard<std::mutex> guard(manager->instanceLock_);
+                manager->retiring_.erase(std::make_pair(std::string(appId), instanceid));
+            }
+        });
+    }
+}
+
+/** Stops an instance that we're retiring. Called on the registry thread,
+    implementations should override this with a stop that doesn't wait
+    for the instance to go away. */
+void Base::retireInstance(const AppID& appId, const std::string& job, const std::string& instance)
+{
+    existing(appId, job, instance, {})->stop();
+}
+
+/** Tells other processes that we're retiring an instance, so that they
+    report its stop with the RETIRED reason as well. */
+void Base::emitRetired(const AppID& appId, const std::string& instance)
+{
+    auto reg = getReg();
+
+    GError* error = nullptr;
+    GVariantBuilder params;
+    g_variant_builder_init(&params, G_VARIANT_TYPE_TUPLE);
+    g_variant_builder_add_value(&params, g_variant_new_string(std::string(appId).c_str()));
+    g_variant_builder_add_value(&params, g_variant_new_string(instance.c_str()));
+    g_dbus_connection_emit_signal(reg->_dbus.get(),                /* bus */
+                                  nullptr,                         /* destination */
+                                  "/",                             /* path */
+                                  "com.canonical.UbuntuAppLaunch", /* interface */
+                                  "ApplicationRetired",            /* signal */
+                                  g_variant_builder_end(&params),  /* params */
+                                  &error);                         /* error */
+
+    if (error != nullptr)
+    {
+        g_warning("Unable to emit signal 'ApplicationRetired' for appid '%s': '%s'", std::string(appId).c_str(),
+                  error->message);
+        g_error_free(error);
+    }
+}
+
+/** Looks at a failed job and if it is an application that crashed
+    schedules it to be launched again, backing off on each crash. */
+void Base::restartCrashed(const std::string& job, const std::string& appid, Registry::FailureType reason)
+{
+    if (!restartPolicy_.enabled || reason != Registry::FailureType::CRASH)
+    {
+        return;
+    }
+
+    if (std::find(allApplicationJobs_.begin(), allApplicationJobs_.end(), job) == allApplicationJobs_.end())
+    {
+        /* Not an application */
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto& data = restarts_[appid];
+
+    if (data.count > 0 && now - data.lastRestart > restartPolicy_.stableTime)
+    {
+        data.count = 0;
+    }
+
+    if (data.count >= restartPolicy_.maxRestarts)
+    {
+        g_warning("Application '%s' crashed %d times, not restarting it", appid.c_str(), int(data.count));
+        return;
+    }
+
+    auto delay = restartPolicy_.initialDelay;
+    for (unsigned int i = 0; i < data.count && delay < restartPolicy_.maxDelay; i++)
+    {
+        delay *= 2;
+    }
+    delay = std::min(delay, restartPolicy_.maxDelay);
+
+    data.count++;
+    data.lastRestart = now + delay;
+
+    g_debug("Restarting crashed application '%s' in %d ms", appid.c_str(), int(delay.count()));
+
+    auto reg = getReg();
+    std::weak_ptr<Registry::Impl> weakReg = reg;
+    reg->thread.timeout(delay, [weakReg, appid]() {
+        auto reg = weakReg.lock();
+        if (!reg)
+        {
+            return;
+        }
+
+        try
+        {
+            auto app = reg->createApp(reg->find(appid));
+            app->launch();
+        }
+        catch (std::runtime_error& e)
+        {
+            g_warning("Unable to restart application '%s': %s", appid.c_str(), e.what());
+        }
+    });
+}
+
+/** Drops the restart tracking for an application when its unit goes
+    away, unless a restart is pending or it crashed recently enough that
+    the count still matters. */
+void Base::pruneRestarts(const std::string& job, const std::string& appid)
+{
+    if (std::find(allApplicationJobs_.begin(), allApplicationJobs_.end(), job) == allApplicationJobs_.end())
+    {
+        return;
+    }
+
+    auto entry = restarts_.find(appid);
+    if (entry == restarts_.end())
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (entry->second.count < restartPolicy_.maxRestarts && now - entry->second.lastRestart <= restartPolicy_.stableTime)
+    {
+        return;
+    }
+
+    g_debug("Dropping restart tracking for '%s'", appid.c_str());
+    restarts_.erase(entry);
+}
+
 /** Get application objects for all of the applications based
     on the appids associated with the application jobs */
 std::list<std::shared_ptr<Application>> Base::runningApps()
@@ -752,6 +1522,81 @@ void Base::resume()
     pidListToDbus(registry_, appId_, instance_, pids, "ApplicationResumed");
 }
 
+/** Pauses the application, saves its processes with the checkpointer
+    and then stops it. The image is used on the next launch. Only done for
+    applications that ask for it as not everything survives a restore.
+    Saving happens on the registry thread, @finished is called there once
+    it is done. */
+bool Base::hibernate(const std::function<void(bool)>& finished)
+{
+    auto checkpointer = registry_->getCheckpointer();
+    if (!checkpointer)
+    {
+        g_debug("No checkpointer, unable to hibernate: %s", std::string(appId_).c_str());
+        return false;
+    }
+
+    try
+    {
+        auto desktop = std::dynamic_pointer_cast<app_info::Desktop>(registry_->createApp(appId_)->info());
+        if (!desktop || !desktop->hibernate())
+        {
+            g_debug("Application doesn't support hibernate: %s", std::string(appId_).c_str());
+            return false;
+        }
+    }
+    catch (std::runtime_error& e)
+    {
+        g_warning("Unable to get info to hibernate '%s': %s", std::string(appId_).c_str(), e.what());
+        return false;
+    }
+
+    auto pid = primaryPid();
+    if (pid == 0)
+    {
+        return false;
+    }
+
+    g_debug("Hibernating application: %s", std::string(appId_).c_str());
+    pause();
+
+    std::weak_ptr<Registry::Impl> weakReg = registry_;
+    auto appId = appId_;
+    auto job = job_;
+    auto instance = instance_;
+    registry_->thread.executeOnThread([weakReg, checkpointer, appId, job, instance, pid, finished] {
+        auto reg = weakReg.lock();
+        if (!reg)
+        {
+            return;
+        }
+
+        checkpointer->checkpoint(
+            appId, pid, reg->thread.getCancellable().get(), [weakReg, appId, job, instance, finished](bool saved) {
+                auto reg = weakReg.lock();
+                if (saved && reg)
+                {
+                    try
+                    {
+                        reg->jobs()->existing(appId, job, instance, {})->stop();
+                    }
+                    catch (std::runtime_error& e)
+                    {
+                        g_warning("Unable to stop hibernated '%s': %s", std::string(appId).c_str(), e.what());
+                        saved = false;
+                    }
+                }
+
+                if (finished)
+                {
+                    finished(saved);
+                }
+            });
+    });
+
+    return true;
+}
+
 /** Focuses this application by sending SIGCONT to all the PIDs in the
     cgroup and tells the Shell to focus the application. */
 void Base::focus()
@@ -25,8 +25,12 @@
 #include "string-util.h"
 
 #include <core/signal.h>
+#include <atomic>
 #include <gio/gio.h>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 
 namespace ubuntu
@@ -53,6 +57,7 @@ public:
     void pause() override;
     void resume() override;
     void focus() override;
+    bool hibernate(const std::function<void(bool)>& finished = nullptr);
 
     const std::string& getInstanceId() const
     {
@@ -106,7 +111,7 @@ enum class launchMode
     TEST      /**< Include testing environment vars */
 };
 
-class Base
+class Base : public std::enable_shared_from_this<Base>
 {
 public:
     Base(const std::shared_ptr<Registry::Impl>& registry);
@@ -120,6 +125,14 @@ public:
         launchMode mode,
         std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv) = 0;
 
+    virtual std::shared_ptr<Application::Instance> activate(
+        const AppID& appId,
+        const std::string& job,
+        const std::string& instance,
+        const std::vector<Application::URL>& urls,
+        const std::vector<Helper::Endpoint>& endpoints,
+        std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv) = 0;
+
     virtual std::shared_ptr<Application::Instance> existing(const AppID& appId,
                                                             const std::string& job,
                                                             const std::string& instance,
@@ -171,6 +184,21 @@ public:
     virtual void setManager(std::shared_ptr<Registry::Manager> manager);
     virtual void clearManager();
 
+    /* Crash restarts */
+    virtual void setRestartPolicy(const Registry::RestartPolicy& policy);
+
+    /* Usage tracking */
+    virtual void trackUsage();
+
+    /* Filtered lifecycle events */
+    virtual std::shared_ptr<Registry::LifecycleSubscription> subscribeLifecycle(
+        const Registry::LifecycleFilter& filter, std::function<void(const Registry::LifecycleChange&)> callback);
+
+    /* Instance caps */
+    virtual void setInstanceCaps(const Registry::InstanceCaps& caps);
+    virtual void trackInstances();
+    void retireInstances(const AppID& appId, const std::string& job);
+
 protected:
     /** Accessor function to the registry that ensures we can still
         get it, which we always should be able to, but in case. */
@@ -187,6 +215,9 @@ protected:
     /** Application manager instance */
     std::shared_ptr<Registry::Manager> manager_;
 
+    virtual void retireInstance(const AppID& appId, const std::string& job, const std::string& instance);
+    bool instanceRetired(const std::string& appid, const std::string& instance);
+
 private:
     /** A link to the registry */
     std::weak_ptr<Registry::Impl> registry_;
@@ -194,6 +225,84 @@ private:
     /** A set of all the job names used by applications */
     std::list<std::string> allApplicationJobs_;
 
+    /** Policy for restarting crashed applications */
+    Registry::RestartPolicy restartPolicy_;
+    /** Restart tracking for an application */
+    struct RestartData
+    {
+        unsigned int count;                                /**< Restarts since it was last stable */
+        std::chrono::steady_clock::time_point lastRestart; /**< When we last restarted it */
+    };
+    /** Restart tracking for each AppID that has crashed */
+    std::map<std::string, RestartData> restarts_;
+    std::once_flag flag_restartPolicy; /**< Variable to track if we're watching for failures to restart */
+    void restartCrashed(const std::string& job, const std::string& appid, Registry::FailureType reason);
+    void pruneRestarts(const std::string& job, const std::string& appid);
+
+    std::once_flag flag_trackUsage; /**< Variable to track if we're sending job events to the usage ledger */
+    /** Lifecycle subscription feeding the usage ledger */
+    std::shared_ptr<Registry::LifecycleSubscription> usageTracking_;
+
+    /** A filtered lifecycle subscription, the caller holds the only strong
+        reference so it goes away when they drop it */
+    class LifecycleSubscriber : public Registry::LifecycleSubscription
+    {
+    public:
+        ~LifecycleSubscriber();
+
+        Registry::LifecycleFilter filter;                                /**< Events wanted */
+        std::function<void(const Registry::LifecycleChange&)> callback; /**< Where to send them */
+        std::weak_ptr<Base> manager; /**< Told when we go away so that it can drop our events */
+    };
+    /** Subscribers for a single job type */
+    struct LifecycleIndex
+    {
+        /** Subscribers for exact AppIDs, looked up directly */
+        std::map<std::string, std::list<std::weak_ptr<LifecycleSubscriber>>> byAppId;
+        /** Subscribers with a pattern or no AppID, checked on every event */
+        std::list<std::weak_ptr<LifecycleSubscriber>> patterns;
+    };
+    /** Lifecycle subscribers by job type, an empty job for any */
+    std::map<std::string, LifecycleIndex> lifecycleSubscribers_;
+    /** Protects the lifecycle subscribers */
+    std::mutex lifecycleLock_;
+    /** All the events any subscriber has asked for, so the rest can be dropped early */
+    std::atomic<unsigned int> lifecycleEvents_;
+    std::once_flag flag_lifecycleJobs;   /**< Variable to track if job events are sent to lifecycle subscribers */
+    std::once_flag flag_lifecyclePauses; /**< Variable to track if pause events are sent to lifecycle subscribers */
+    ManagedDBusSignalConnection handle_lifecyclePaused{
+        DBusSignalUnsubscriber{}}; /**< GDBus signal watcher handle for app paused lifecycle events */
+    ManagedDBusSignalConnection handle_lifecycleResumed{
+        DBusSignalUnsubscriber{}}; /**< GDBus signal watcher handle for app resumed lifecycle events */
+    ManagedDBusSignalConnection handle_lifecycleRetired{
+        DBusSignalUnsubscriber{}}; /**< GDBus signal watcher handle for instances retired by other processes */
+    void dispatchLifecycle(const Registry::LifecycleChange& change);
+    void lifecycleUnsubscribed();
+    guint lifecyclePauseSignal(const std::string& signalname, Registry::LifecycleEvent event);
+    std::string applicationJob(const std::string& appid, const std::string& instance);
+
+    /** Caps on the number of instances of each job */
+    Registry::InstanceCaps instanceCaps_;
+    /** What we know about a running instance */
+    struct InstanceState
+    {
+        bool paused;                                       /**< Whether it is paused */
+        std::chrono::steady_clock::time_point lastResumed; /**< When it was last started or resumed */
+    };
+    /** Instances we've seen events for, by AppID and instance ID */
+    std::map<std::pair<std::string, std::string>, InstanceState> instanceStates_;
+    /** Instances we've asked to stop to stay under a cap */
+    std::set<std::pair<std::string, std::string>> retiring_;
+    /** Protects the instance caps and state */
+    std::mutex instanceLock_;
+    /** Our lifecycle subscription for tracking which instances are paused */
+    std::shared_ptr<Registry::LifecycleSubscription> instanceTracking_;
+    std::once_flag flag_trackInstances; /**< Variable to track if we're tracking instances for the caps */
+    unsigned int instanceCap(const std::string& appid, const std::string& job);
+    void instanceChanged(const Registry::LifecycleChange& change);
+    guint lifecycleRetiredSignal();
+    void emitRetired(const AppID& appId, const std::string& instance);
+
     /** Signal object for applications started */
     core::Signal<const std::shared_ptr<Application>&, const std::shared_ptr<Application::Instance>&> sig_appStarted;
     /** Signal object for applications stopped */
@@ -29,11 +29,12 @@ extern "C" {
 }
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <algorithm>
-#include <numeric>
+#include <cerrno>
 #include <regex>
 #include <unity/util/GlibMemory.h>
 
@@ -69,6 +70,8 @@ public:
 
     /* Manage lifecycle */
     void stop() override;
+    void pause() override;
+    void resume() override;
 
 };  // class SystemD
 
@@ -100,6 +103,24 @@ void SystemD::stop()
     manager->stopUnit(appId_, job_, instance_);
 }
 
+/** The shell only pauses or resumes applications that are up and
+    running, so the launch boost is no longer needed. */
+void SystemD::pause()
+{
+    auto manager = std::dynamic_pointer_cast<manager::SystemD>(registry_->jobs());
+    manager->unitReady(appId_, job_, instance_);
+
+    Base::pause();
+}
+
+void SystemD::resume()
+{
+    auto manager = std::dynamic_pointer_cast<manager::SystemD>(registry_->jobs());
+    manager->unitReady(appId_, job_, instance_);
+
+    Base::resume();
+}
+
 }  // namespace instance
 
 namespace manager
@@ -111,11 +132,38 @@ static const char* SYSTEMD_DBUS_PATH_MANAGER{"/org/freedesktop/systemd1"};
 // static const char * SYSTEMD_DBUS_IFACE_UNIT{"org.freedesktop.systemd1.Unit"};
 static const char* SYSTEMD_DBUS_IFACE_SERVICE{"org.freedesktop.systemd1.Service"};
 
+/** Size of the URL list, in bytes, above which we hand the URLs to
+    applications that support it in a file instead of on their command line */
+static const std::size_t URIS_FILE_THRESHOLD_DEFAULT{64 * 1024};
+
+/** How long we'll wait for a unit that is going away, typically a
+    crashed app that is dumping core, before giving up on launching
+    a new instance in its place */
+static const std::chrono::milliseconds RELAUNCH_TIMEOUT_DEFAULT{5000};
+
+/** Number of times we'll try to start a unit that keeps colliding
+    with an old one before we give up */
+static const unsigned int RELAUNCH_MAX_ATTEMPTS{10};
+
+/** CPU and IO weight given to applications while they're starting */
+static const std::uint64_t BOOST_WEIGHT_DEFAULT{1000};
+
+/** Largest weight systemd accepts */
+static const std::uint64_t BOOST_WEIGHT_MAX{10000};
+
+/** Weight applications go back to after starting, the systemd default */
+static const std::uint64_t NORMAL_WEIGHT{100};
+
+/** How long an application keeps the launch boost if we never hear
+    that it is ready */
+static const std::chrono::milliseconds BOOST_TIMEOUT_DEFAULT{5000};
+
 SystemD::SystemD(const std::shared_ptr<Registry::Impl>& registry)
     : Base(registry)
     , handle_unitNew(DBusSignalUnsubscriber{})
     , handle_unitRemoved(DBusSignalUnsubscriber{})
     , handle_appFailed(DBusSignalUnsubscriber{})
+    , unitPathsAccount_(std::make_shared<MemoryAccount>("systemd-units", registry->memoryBudget()))
 {
     auto gcgroup_root = getenv("UBUNTU_APP_LAUNCH_SYSTEMD_CGROUP_ROOT");
     if (gcgroup_root == nullptr)
@@ -134,6 +182,61 @@ SystemD::SystemD(const std::shared_ptr<Registry::Impl>& registry)
         noResetUnits_ = true;
     }
 
+    auto gthreshold = getenv("UBUNTU_APP_LAUNCH_URIS_FILE_THRESHOLD");
+    if (gthreshold != nullptr)
+    {
+        urisFileThreshold_ = std::strtoull(gthreshold, nullptr, 10);
+    }
+    else
+    {
+        urisFileThreshold_ = URIS_FILE_THRESHOLD_DEFAULT;
+    }
+
+    auto grelaunch = getenv("UBUNTU_APP_LAUNCH_SYSTEMD_RELAUNCH_TIMEOUT");
+    if (grelaunch != nullptr)
+    {
+        relaunchTimeout_ = std::chrono::milliseconds{std::strtoull(grelaunch, nullptr, 10)};
+    }
+    else
+    {
+        relaunchTimeout_ = RELAUNCH_TIMEOUT_DEFAULT;
+    }
+
+    if (getenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST") != nullptr)
+    {
+        boostLaunches_ = true;
+    }
+
+    auto gcpuweight = getenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_CPU_WEIGHT");
+    if (gcpuweight != nullptr)
+    {
+        boostCpuWeight_ = std::min<std::uint64_t>(BOOST_WEIGHT_MAX, std::strtoull(gcpuweight, nullptr, 10));
+    }
+    else
+    {
+        boostCpuWeight_ = BOOST_WEIGHT_DEFAULT;
+    }
+
+    auto gioweight = getenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_IO_WEIGHT");
+    if (gioweight != nullptr)
+    {
+        boostIoWeight_ = std::min<std::uint64_t>(BOOST_WEIGHT_MAX, std::strtoull(gioweight, nullptr, 10));
+    }
+    else
+    {
+        boostIoWeight_ = BOOST_WEIGHT_DEFAULT;
+    }
+
+    auto gboosttimeout = getenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_TIMEOUT");
+    if (gboosttimeout != nullptr)
+    {
+        boostTimeout_ = std::chrono::milliseconds{std::strtoull(gboosttimeout, nullptr, 10)};
+    }
+    else
+    {
+        boostTimeout_ = BOOST_TIMEOUT_DEFAULT;
+    }
+
     setupUserbus(registry);
 }
 
@@ -290,6 +393,14 @@ void SystemD::setupUserbus(const std::shared_ptr<Registry::Impl>& reg)
                         return;
                     }
 
+                    /* Nothing can activate the service without its socket */
+                    auto activated = activationServiceName(unitname);
+                    if (!activated.empty())
+                    {
+                        pthis->removeActivation(activated);
+                        return;
+                    }
+
                     try
                     {
                         pthis->parseUnit(unitname);
@@ -313,8 +424,33 @@ void SystemD::setupUserbus(const std::shared_ptr<Registry::Impl>& reg)
     });
 }
 
+/** Units we boosted don't get lowered by anyone else, so we do it
+    before going away */
 SystemD::~SystemD()
 {
+    if (boosts_.empty() || !userbus_)
+    {
+        return;
+    }
+
+    for (const auto& boost : boosts_)
+    {
+        g_debug("Ending boost for unit '%s': shutdown", boost.first.c_str());
+        g_dbus_connection_call(userbus_.get(),                    /* user bus */
+                               SYSTEMD_DBUS_ADDRESS,              /* bus name */
+                               SYSTEMD_DBUS_PATH_MANAGER,         /* path */
+                               SYSTEMD_DBUS_IFACE_MANAGER,        /* interface */
+                               "SetUnitProperties",               /* method */
+                               normalWeightsParams(boost.first),  /* params */
+                               nullptr,                           /* ret type */
+                               G_DBUS_CALL_FLAGS_NONE,            /* flags */
+                               -1,                                /* timeout */
+                               nullptr,                           /* cancellable */
+                               nullptr,                           /* callback */
+                               nullptr);                          /* user data */
+    }
+
+    g_dbus_connection_flush_sync(userbus_.get(), nullptr, nullptr);
 }
 
 void SystemD::getInitialUnits(const std::shared_ptr<GDBusConnection>& bus, const std::shared_ptr<GCancellable>& cancel)
@@ -410,7 +546,8 @@ int SystemD::envSize(std::list<std::pair<std::string, std::string>>& env)
     return len;
 }
 
-std::vector<std::string> SystemD::parseExec(std::list<std::pair<std::string, std::string>>& env)
+std::vector<std::string> SystemD::parseExec(std::list<std::pair<std::string, std::string>>& env,
+                                            const std::vector<Application::URL>& urls)
 {
     auto exec = findEnv("APP_EXEC", env);
     if (exec.empty())
@@ -418,12 +555,24 @@ std::vector<std::string> SystemD::parseExec(std::list<std::pair<std::string, std
         g_warning("Application exec line is empty?!?!?");
         return {};
     }
-    auto uris = findEnv("APP_URIS", env);
 
     g_debug("Exec line: %s", exec.c_str());
-    g_debug("App URLS:  %s", uris.c_str());
+    g_debug("App URLS:  %d", int(urls.size()));
 
-    auto execarray = desktop_exec_parse(exec.c_str(), uris.c_str());
+    /* Pass the URLs straight through, no quoting and parsing them again */
+    std::vector<const gchar*> curls;
+    curls.reserve(urls.size() + 1);
+    for (const auto& url : urls)
+    {
+        curls.push_back(url.value().c_str());
+    }
+    curls.push_back(nullptr);
+
+    auto execarray = desktop_exec_parse_uris(exec.c_str(), curls.data());
+    if (execarray == nullptr)
+    {
+        return {};
+    }
 
     std::vector<std::string> retval;
     for (unsigned int i = 0; i < execarray->len; i++)
@@ -484,13 +633,257 @@ std::vector<std::string> SystemD::parseExec(std::list<std::pair<std::string, std
     return retval;
 }
 
+/** Total size of the URLs in bytes, including a separator for each */
+std::size_t SystemD::urlsSize(const std::vector<Application::URL>& urls)
+{
+    std::size_t size = 0;
+
+    for (const auto& url : urls)
+    {
+        size += url.value().size() + 1;
+    }
+
+    return size;
+}
+
+/** Write the URLs, one per line, into a new file for this launch. Each
+    launch gets its own file so that a launch that ends up going to an
+    instance that is already running can't overwrite the file that instance
+    was started with. It lives in the user's runtime directory so that it
+    is private and goes away with the session. Returns the path to the file
+    or an empty string if it couldn't be written.
+
+    \param unitname Name of the unit that will read the file
+    \param urls URLs to write into the file
+*/
+std::string SystemD::writeUrisFile(const std::string& unitname, const std::vector<Application::URL>& urls)
+{
+    auto dir = unique_gchar(g_build_filename(g_get_user_runtime_dir(), "ubuntu-app-launch", "uris", nullptr));
+
+    if (g_mkdir_with_parents(dir.get(), 0700) != 0)
+    {
+        g_warning("Unable to create directory for URL list: %s", dir.get());
+        return {};
+    }
+
+    auto cpath = unique_gchar(g_build_filename(dir.get(), (unitname + "-XXXXXX").c_str(), nullptr));
+    auto fd = g_mkstemp(cpath.get());
+    if (fd < 0)
+    {
+        g_warning("Unable to create URL list file for '%s': %s", unitname.c_str(), g_strerror(errno));
+        return {};
+    }
+    close(fd);
+    std::string path{cpath.get()};
+
+    std::string contents;
+    contents.reserve(urlsSize(urls));
+    for (const auto& url : urls)
+    {
+        contents += url.value();
+        contents += '\n';
+    }
+
+    GError* error{nullptr};
+    g_file_set_contents(path.c_str(), contents.c_str(), contents.size(), &error);
+
+    if (error != nullptr)
+    {
+        g_warning("Unable to write URL list to '%s': %s", path.c_str(), error->message);
+        g_error_free(error);
+        g_unlink(path.c_str());
+        return {};
+    }
+
+    return path;
+}
+
 /** Small helper that we can new/delete to work better with C stuff */
 struct StartCHelper
 {
     std::shared_ptr<instance::SystemD> ptr;
     std::shared_ptr<GDBusConnection> bus;
+    /** Unit that we're asking systemd to start */
+    std::string unitname;
+    /** Parameters for StartTransientUnit so that we can send them again */
+    std::shared_ptr<GVariant> params;
+    /** When we give up waiting for an old unit with the same name to go away */
+    std::chrono::steady_clock::time_point deadline;
+    /** Number of times we've asked systemd to start the unit */
+    unsigned int attempts{0};
+    /** Timeout source while we're waiting on the old unit */
+    guint timeout{0};
+    /** File with the URLs for the new unit, removed if the unit isn't created */
+    std::string urisfile;
+    /** Checkpointer the unit claimed an image from, if it is restoring one */
+    std::shared_ptr<checkpointer::Base> restoring;
+    /** Whether the unit was created with the launch boost */
+    bool boost{false};
 };
 
+/** Cleans up after a launch that didn't create its unit. The URL list
+    is removed and a claimed checkpoint goes back to the application so
+    that the next launch can still restore it. */
+static void abandonLaunch(const StartCHelper& data)
+{
+    if (!data.urisfile.empty())
+    {
+        g_unlink(data.urisfile.c_str());
+    }
+
+    if (data.restoring)
+    {
+        data.restoring->unclaim(data.ptr->getAppId(), data.unitname);
+    }
+}
+
+/** Sends the StartTransientUnit request to systemd, the helper is owned
+    by the callback from here on out. */
+void SystemD::startTransientUnit(StartCHelper* data)
+{
+    auto reg = getReg();
+    data->attempts++;
+
+    g_debug("Asking systemd to start unit: %s", data->unitname.c_str());
+    g_dbus_connection_call(userbus_.get(),                     /* bus */
+                           SYSTEMD_DBUS_ADDRESS,               /* service name */
+                           SYSTEMD_DBUS_PATH_MANAGER,          /* Path */
+                           SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
+                           "StartTransientUnit",               /* method */
+                           data->params.get(),                 /* params */
+                           G_VARIANT_TYPE("(o)"),              /* return */
+                           G_DBUS_CALL_FLAGS_NONE,             /* flags */
+                           -1,                                 /* default timeout */
+                           reg->thread.getCancellable().get(), /* cancellable */
+                           application_start_cb,               /* callback */
+                           data                                /* object */
+                           );
+}
+
+/** Looks up the ActiveState of a loaded unit, only asking systemd about
+    that one unit. The callback gets an empty string if the unit isn't
+    loaded or we're unable to ask systemd. */
+void SystemD::unitActiveState(const std::string& unitname, const std::function<void(const std::string&)>& callback)
+{
+    auto reg = getReg();
+    const gchar* names[] = {unitname.c_str(), nullptr};
+
+    g_dbus_connection_call(
+        userbus_.get(),                                  /* user bus */
+        SYSTEMD_DBUS_ADDRESS,                            /* bus name */
+        SYSTEMD_DBUS_PATH_MANAGER,                       /* path */
+        SYSTEMD_DBUS_IFACE_MANAGER,                      /* interface */
+        "ListUnitsByNames",                              /* method */
+        g_variant_new("(^as)", names),                   /* params */
+        G_VARIANT_TYPE("(a(ssssssouso))"),               /* ret type */
+        G_DBUS_CALL_FLAGS_NONE,                          /* flags */
+        -1,                                              /* timeout */
+        reg->thread.getCancellable().get(),              /* cancellable */
+        [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+            auto callback = std::unique_ptr<std::function<void(const std::string&)>>(
+                static_cast<std::function<void(const std::string&)>*>(user_data));
+            GError* error{nullptr};
+
+            auto callt = unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
+
+            if (error != nullptr)
+            {
+                if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                {
+                    g_warning("Unable to get SystemD unit state: %s", error->message);
+                }
+                g_error_free(error);
+                (*callback)({});
+                return;
+            }
+
+            auto call = unique_glib(g_variant_get_child_value(callt.get(), 0));
+
+            std::string state;
+            const gchar* loadState;
+            const gchar* activeState;
+            auto iter = unique_glib(g_variant_iter_new(call.get()));
+            if (g_variant_iter_next(iter.get(), "(&s&s&s&s&s&s&ou&s&o)", nullptr, nullptr, &loadState,
+                                    &activeState, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr) &&
+                g_strcmp0(loadState, "not-found") != 0)
+            {
+                state = activeState;
+            }
+
+            (*callback)(state);
+        },
+        new std::function<void(const std::string&)>(callback));
+}
+
+/** Handles a launch that collided with an old unit of the same name
+    that is on its way out. Sending URLs to it would lose them, so we
+    wait for systemd to remove it and start our unit then. If it takes
+    too long we report the launch as failed.
+
+    \param rawdata Launch helper, we take ownership of it
+    \param state ActiveState of the old unit
+*/
+void SystemD::startAfterUnit(StartCHelper* rawdata, const std::string& state)
+{
+    auto data = std::shared_ptr<StartCHelper>(rawdata);
+    auto reg = getReg();
+    auto info = parseUnit(data->unitname);
+    auto now = std::chrono::steady_clock::now();
+
+    if (now >= data->deadline || data->attempts >= RELAUNCH_MAX_ATTEMPTS)
+    {
+        g_warning("Unit '%s' didn't go away, unable to start a new instance", data->unitname.c_str());
+        abandonLaunch(*data);
+        sig_jobFailed(info.job, info.appid, info.inst, Registry::FailureType::START_FAILURE);
+        return;
+    }
+
+    if (state.empty())
+    {
+        /* Already gone, try again */
+        g_debug("Unit '%s' is gone, starting again", data->unitname.c_str());
+        startTransientUnit(new StartCHelper(*data));
+        return;
+    }
+
+    g_debug("Waiting for '%s' unit to go away, it is '%s'", data->unitname.c_str(), state.c_str());
+
+    /* Failed units stick around until they're reset, crashed apps end up
+       here after deactivating so we make sure we're watching for that */
+    if (state == "failed")
+    {
+        resetUnit(info);
+    }
+    watchFailures();
+
+    std::weak_ptr<Registry::Impl> weakReg = reg;
+    auto unitname = data->unitname;
+    data->timeout = reg->thread.timeout(
+        std::chrono::duration_cast<std::chrono::milliseconds>(data->deadline - now),
+        [weakReg, unitname, data]() {
+            auto reg = weakReg.lock();
+            if (!reg)
+            {
+                return;
+            }
+
+            auto manager = std::dynamic_pointer_cast<SystemD>(reg->jobs());
+            auto& pending = manager->pendingStarts_[unitname];
+            pending.remove(data);
+            if (pending.empty())
+            {
+                manager->pendingStarts_.erase(unitname);
+            }
+
+            g_warning("Timed out waiting for unit '%s' to go away, unable to start a new instance", unitname.c_str());
+            abandonLaunch(*data);
+            auto info = manager->parseUnit(unitname);
+            manager->sig_jobFailed(info.job, info.appid, info.inst, Registry::FailureType::START_FAILURE);
+        });
+
+    pendingStarts_[data->unitname].push_back(data);
+}
+
 void SystemD::application_start_cb(GObject* obj, GAsyncResult* res, gpointer user_data)
 {
     auto data = static_cast<StartCHelper*>(user_data);
@@ -505,36 +898,61 @@ void SystemD::application_start_cb(GObject* obj, GAsyncResult* res, gpointer use
        have a leak. */
     unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
 
-    if (error != nullptr)
+    if (error == nullptr)
     {
-        if (g_dbus_error_is_remote_error(error))
+        /* Only a unit we created has our weights */
+        if (data->boost)
         {
-            gchar* remote_error = g_dbus_error_get_remote_error(error);
-            g_debug("Remote error: %s", remote_error);
-            if (g_strcmp0(remote_error, "org.freedesktop.systemd1.UnitExists") == 0)
-            {
-                auto urls = instance::SystemD::urlsToStrv(data->ptr->urls_);
-                second_exec(data->bus.get(),                                     /* DBus */
-                            data->ptr->registry_->thread.getCancellable().get(), /* cancellable */
-                            data->ptr->primaryPid(),                             /* primary pid */
-                            std::string(data->ptr->appId_).c_str(),              /* appid */
-                            data->ptr->instance_.c_str(),                        /* instance */
-                            urls.get());                                         /* urls */
-            }
-
-            g_free(remote_error);
+            auto manager = std::dynamic_pointer_cast<manager::SystemD>(data->ptr->registry_->jobs());
+            manager->startBoost(data->unitname, std::string(data->ptr->appId_));
         }
-        else
+
+        delete data;
+        return;
+    }
+
+    gchar* remote_error{nullptr};
+    if (g_dbus_error_is_remote_error(error))
+    {
+        remote_error = g_dbus_error_get_remote_error(error);
+        g_debug("Remote error: %s", remote_error);
+    }
+    else if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_warning("Unable to emit event to start application: %s", error->message);
+    }
+
+    bool exists = g_strcmp0(remote_error, "org.freedesktop.systemd1.UnitExists") == 0;
+    g_free(remote_error);
+    g_error_free(error);
+
+    if (!exists)
+    {
+        abandonLaunch(*data);
+        delete data;
+        return;
+    }
+
+    auto manager = std::dynamic_pointer_cast<manager::SystemD>(data->ptr->registry_->jobs());
+    manager->unitActiveState(data->unitname, [manager, data](const std::string& state) {
+        if (state.empty() || state == "deactivating" || state == "failed" || state == "inactive")
         {
-            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-            {
-                g_warning("Unable to emit event to start application: %s", error->message);
-            }
+            /* The old one is dying, likely a crash, don't hand it our URLs */
+            manager->startAfterUnit(data, state);
+            return;
         }
-        g_error_free(error);
-    }
 
-    delete data;
+        /* The running instance gets the URLs directly */
+        abandonLaunch(*data);
+        auto urls = instance::SystemD::urlsToStrv(data->ptr->urls_);
+        second_exec(data->bus.get(),                                     /* DBus */
+                    data->ptr->registry_->thread.getCancellable().get(), /* cancellable */
+                    data->ptr->primaryPid(),                             /* primary pid */
+                    std::string(data->ptr->appId_).c_str(),              /* appid */
+                    data->ptr->instance_.c_str(),                        /* instance */
+                    urls.get());                                         /* urls */
+        delete data;
+    });
 }
 
 void SystemD::copyEnv(const std::string& envname, std::list<std::pair<std::string, std::string>>& env)
@@ -578,6 +996,69 @@ std::shared_ptr<Application::Instance> SystemD::launch(
     const std::vector<Application::URL>& urls,
     launchMode mode,
     std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv)
+{
+    return startUnit(appId, job, instance, urls, mode, {}, getenv);
+}
+
+/** Sets up a helper to be started by systemd the first time one of
+    its endpoints is used. We make a transient socket unit that has the
+    service unit as an auxiliary unit, it is loaded, and so tracked, but
+    not started until the socket is used. D-Bus names get a service file
+    that points the bus at the service unit. */
+std::shared_ptr<Application::Instance> SystemD::activate(
+    const AppID& appId,
+    const std::string& job,
+    const std::string& instance,
+    const std::vector<Application::URL>& urls,
+    const std::vector<Helper::Endpoint>& endpoints,
+    std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv)
+{
+    auto appJobs = getAllApplicationJobs();
+    if (std::find(appJobs.begin(), appJobs.end(), job) != appJobs.end())
+    {
+        throw std::runtime_error{"Only helpers can be activated, not '" + job + "' jobs"};
+    }
+
+    if (endpoints.empty())
+    {
+        throw std::runtime_error{"No endpoints to activate '" + std::string(appId) + "' with"};
+    }
+
+    for (const auto& endpoint : endpoints)
+    {
+        switch (endpoint.kind)
+        {
+            case Helper::Endpoint::Kind::SOCKET:
+                if (!g_path_is_absolute(endpoint.address.c_str()))
+                {
+                    throw std::runtime_error{"Socket path isn't absolute: " + endpoint.address};
+                }
+                break;
+            case Helper::Endpoint::Kind::DBUS_NAME:
+                if (!g_dbus_is_name(endpoint.address.c_str()) || g_dbus_is_unique_name(endpoint.address.c_str()))
+                {
+                    throw std::runtime_error{"Invalid well known D-Bus name: " + endpoint.address};
+                }
+                break;
+        }
+    }
+
+    /* Make sure the unit can have a socket before setting anything up */
+    activationSocketName(unitName(SystemD::UnitInfo{appId, job, instance}));
+
+    return startUnit(appId, job, instance, urls, launchMode::STANDARD, endpoints, getenv);
+}
+
+/** Builds up the unit for the job and asks systemd to start it, or to
+    wait for one of its endpoints to be used if there are any. */
+std::shared_ptr<Application::Instance> SystemD::startUnit(
+    const AppID& appId,
+    const std::string& job,
+    const std::string& instance,
+    const std::vector<Application::URL>& urls,
+    launchMode mode,
+    const std::vector<Helper::Endpoint>& endpoints,
+    std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv)
 {
     if (appId.empty())
         return {};
@@ -593,6 +1074,12 @@ std::shared_ptr<Application::Instance> SystemD::launch(
 
         tracepoint(ubuntu_app_launch, libual_start, appIdStr.c_str());
 
+        /* Make room for a new instance, single instance jobs don't have an ID */
+        if (!instance.empty())
+        {
+            manager->retireInstances(appId, job);
+        }
+
         int timeout = 1;
         if (ubuntu::app_launch::Registry::Impl::isWatchingAppStarting())
         {
@@ -649,52 +1136,54 @@ std::shared_ptr<Application::Instance> SystemD::launch(
             env.emplace_back(std::make_pair("MIR_SOCKET", g_get_user_runtime_dir() + std::string{"/mir_socket"}));
         }
 
-        if (!urls.empty())
+        /* Applications that can read their URLs from a file get large sets
+           of them that way, with UBUNTU_APP_LAUNCH_URIS_FILE telling them
+           where it is. Everyone else gets them on the command line. */
+        removeEnv("UBUNTU_APP_LAUNCH_URIS_FILE", env);
+        std::string urisfile;
+        if (findEnv("APP_URIS_FILE", env) == "1" && !urls.empty() && urlsSize(urls) > manager->urisFileThreshold_)
         {
-            auto accumfunc = [](const std::string& prev, Application::URL thisurl) -> std::string {
-                gchar* gescaped = g_shell_quote(thisurl.value().c_str());
-                std::string escaped;
-                if (gescaped != nullptr)
-                {
-                    escaped = gescaped;
-                    g_free(gescaped);
-                }
-                else
-                {
-                    g_warning("Unable to escape URL: %s", thisurl.value().c_str());
-                    return prev;
-                }
-
-                if (prev.empty())
-                {
-                    return escaped;
-                }
-                else
-                {
-                    return prev + " " + escaped;
-                }
-            };
-            auto urlstring = std::accumulate(urls.begin(), urls.end(), std::string{}, accumfunc);
-            env.emplace_back(std::make_pair("APP_URIS", urlstring));
+            urisfile = writeUrisFile(unitname, urls);
+            if (!urisfile.empty())
+            {
+                env.emplace_back(std::make_pair("UBUNTU_APP_LAUNCH_URIS_FILE", urisfile));
+            }
         }
+        bool urlsInFile = !urisfile.empty();
 
         if (mode == launchMode::TEST)
         {
             env.emplace_back(std::make_pair("QT_LOAD_TESTABILITY", "1"));
         }
 
-        /* Convert to GVariant */
+        /* Convert to GVariant, parameter array */
         GVariantBuilder builder;
-        g_variant_builder_init(&builder, G_VARIANT_TYPE_TUPLE);
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
 
-        g_variant_builder_add_value(&builder, g_variant_new_string(unitname.c_str()));
-        g_variant_builder_add_value(&builder, g_variant_new_string("replace"));  // Job mode
+        /* ExecStart */
+        auto commands = parseExec(env, urlsInFile ? std::vector<Application::URL>{} : urls);
 
-        /* Parameter Array */
-        g_variant_builder_open(&builder, G_VARIANT_TYPE_ARRAY);
+        /* If the application was hibernated we bring back the saved
+           processes instead. They can't get URLs so those get a fresh start. */
+        std::shared_ptr<checkpointer::Base> restoring;
+        auto checkpointer = reg->getCheckpointer();
+        if (isApplication && checkpointer)
+        {
+            if (urls.empty())
+            {
+                auto restore = checkpointer->restore(appId, unitname);
+                if (!restore.empty())
+                {
+                    commands = restore;
+                    restoring = checkpointer;
+                }
+            }
+            else
+            {
+                checkpointer->discard(appId);
+            }
+        }
 
-        /* ExecStart */
-        auto commands = parseExec(env);
         if (!commands.empty())
         {
             g_variant_builder_open(&builder, G_VARIANT_TYPE_TUPLE);
@@ -730,6 +1219,15 @@ std::shared_ptr<Application::Instance> SystemD::launch(
             g_variant_builder_close(&builder);
         }
 
+        /* The unit cleans up its URL list, no matter who is watching */
+        if (urlsInFile)
+        {
+            const gchar* rmargs[] = {"rm", "-f", urisfile.c_str(), nullptr};
+            auto rmcommand = g_variant_new("(s^asb)", URIS_FILE_REMOVE, rmargs, FALSE);
+            g_variant_builder_add(&builder, "(sv)", "ExecStopPost",
+                                  g_variant_new_array(G_VARIANT_TYPE("(sasb)"), &rmcommand, 1));
+        }
+
         /* RemainAfterExit */
         g_variant_builder_open(&builder, G_VARIANT_TYPE_TUPLE);
         g_variant_builder_add_value(&builder, g_variant_new_string("RemainAfterExit"));
@@ -746,6 +1244,23 @@ std::shared_ptr<Application::Instance> SystemD::launch(
         g_variant_builder_close(&builder);
         g_variant_builder_close(&builder);
 
+        /* Give applications a larger share while they start up */
+        bool boost = isApplication && manager->boostEnabled();
+        if (boost)
+        {
+            manager->addBoostProperties(&builder);
+        }
+
+        /* Bus activated helpers are ready when they have the name */
+        for (const auto& endpoint : endpoints)
+        {
+            if (endpoint.kind == Helper::Endpoint::Kind::DBUS_NAME)
+            {
+                g_variant_builder_add(&builder, "(sv)", "BusName", g_variant_new_string(endpoint.address.c_str()));
+                break;
+            }
+        }
+
         /* Working Directory */
         if (!findEnv("APP_DIR", env).empty())
         {
@@ -759,7 +1274,7 @@ std::shared_ptr<Application::Instance> SystemD::launch(
 
         /* Clean up env before shipping it */
         for (const auto& rmenv :
-             {"APP_XMIR_ENABLE", "APP_DIR", "APP_URIS", "APP_EXEC", "APP_EXEC_POLICY", "APP_LAUNCHER_PID",
+             {"APP_XMIR_ENABLE", "APP_DIR", "APP_EXEC", "APP_EXEC_POLICY", "APP_LAUNCHER_PID", "APP_URIS_FILE",
               "INSTANCE_ID", "MIR_SERVER_PLATFORM_PATH", "MIR_SERVER_PROMPT_FILE", "MIR_SERVER_HOST_SOCKET",
               "UBUNTU_APP_LAUNCH_OOM_HELPER", "UBUNTU_APP_LAUNCH_LEGACY_ROOT", "UBUNTU_APP_LAUNCH_XMIR_HELPER"})
         {
@@ -788,15 +1303,30 @@ std::shared_ptr<Application::Instance> SystemD::launch(
         g_variant_builder_close(&builder);
 
         /* Parameter Array */
-        g_variant_builder_close(&builder);
+        auto props = g_variant_builder_end(&builder);
 
-        /* Dependent Units (none) */
-        g_variant_builder_add_value(&builder, g_variant_new_array(G_VARIANT_TYPE("(sa(sv))"), nullptr, 0));
+        GVariant* params{nullptr};
+        if (endpoints.empty())
+        {
+            /* Job mode replace and no auxiliary units */
+            params = g_variant_new("(ss@a(sv)@a(sa(sv)))", unitname.c_str(), "replace", props,
+                                   g_variant_new_array(G_VARIANT_TYPE("(sa(sv))"), nullptr, 0));
+        }
+        else
+        {
+            params = manager->activationParams(unitname, props, endpoints);
+        }
 
         auto retval = std::make_shared<instance::SystemD>(appId, job, instance, urls, reg);
         auto chelper = new StartCHelper{};
         chelper->ptr = retval;
         chelper->bus = reg->_dbus;
+        chelper->unitname = unitname;
+        chelper->params = share_glib(g_variant_ref_sink(params));
+        chelper->deadline = std::chrono::steady_clock::now() + manager->relaunchTimeout_;
+        chelper->urisfile = urisfile;
+        chelper->restoring = restoring;
+        chelper->boost = boost;
 
         tracepoint(ubuntu_app_launch, handshake_wait, appIdStr.c_str());
         starting_handshake_wait(handshake);
@@ -804,19 +1334,7 @@ std::shared_ptr<Application::Instance> SystemD::launch(
 
         /* Call the job start function */
         g_debug("Asking systemd to start task for: %s", appIdStr.c_str());
-        g_dbus_connection_call(manager->userbus_.get(),            /* bus */
-                               SYSTEMD_DBUS_ADDRESS,               /* service name */
-                               SYSTEMD_DBUS_PATH_MANAGER,          /* Path */
-                               SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
-                               "StartTransientUnit",               /* method */
-                               g_variant_builder_end(&builder),    /* params */
-                               G_VARIANT_TYPE("(o)"),              /* return */
-                               G_DBUS_CALL_FLAGS_NONE,             /* flags */
-                               -1,                                 /* default timeout */
-                               reg->thread.getCancellable().get(), /* cancellable */
-                               application_start_cb,               /* callback */
-                               chelper                             /* object */
-                               );
+        manager->startTransientUnit(chelper);
 
         tracepoint(ubuntu_app_launch, libual_start_message_sent, appIdStr.c_str());
 
@@ -913,16 +1431,58 @@ std::string SystemD::unitName(const SystemD::UnitInfo& info) const
 std::string SystemD::unitPath(const SystemD::UnitInfo& info)
 {
     auto reg = getReg();
-    auto data = unitPaths[info];
 
-    if (!data)
+    /* Execute on the thread so that we're sure that we're not in
+       a dbus call to get the value, and the units aren't changing
+       under us. No racey for you! If the lookup from when the unit
+       was new hasn't come back we ask ourselves. */
+    return reg->thread.executeOnThread<std::string>([this, &info]() -> std::string {
+        /* Use find so that looking up units that aren't running
+           doesn't leave empty entries behind */
+        auto it = unitPaths.find(info);
+        if (it == unitPaths.end() || !it->second)
+        {
+            unitPathsAccount_->miss();
+            return {};
+        }
+        unitPathsAccount_->hit();
+
+        auto data = it->second;
+        if (data->unitpath.empty())
+        {
+            data->unitpath = getUnitPath(unitName(info));
+        }
+        return data->unitpath;
+    });
+}
+
+/** Asks systemd for the object path of a unit, empty if it can't
+    tell us. Only called on the registry thread. */
+std::string SystemD::getUnitPath(const std::string& name)
+{
+    GError* error{nullptr};
+    auto call = unique_glib(g_dbus_connection_call_sync(userbus_.get(),                          /* user bus */
+                                                        SYSTEMD_DBUS_ADDRESS,                    /* bus name */
+                                                        SYSTEMD_DBUS_PATH_MANAGER,               /* path */
+                                                        SYSTEMD_DBUS_IFACE_MANAGER,              /* interface */
+                                                        "GetUnit",                               /* method */
+                                                        g_variant_new("(s)", name.c_str()),      /* params */
+                                                        G_VARIANT_TYPE("(o)"),                   /* ret type */
+                                                        G_DBUS_CALL_FLAGS_NONE,                  /* flags */
+                                                        -1,                                      /* timeout */
+                                                        getReg()->thread.getCancellable().get(), /* cancellable */
+                                                        &error));
+
+    if (error != nullptr)
     {
+        g_warning("Unable to get SystemD unit path for '%s': %s", name.c_str(), error->message);
+        g_error_free(error);
         return {};
     }
 
-    /* Execute on the thread so that we're sure that we're not in
-       a dbus call to get the value. No racey for you! */
-    return reg->thread.executeOnThread<std::string>([&data]() { return data->unitpath; });
+    const gchar* gpath{nullptr};
+    g_variant_get(call.get(), "(&o)", &gpath);
+    return gpath != nullptr ? gpath : std::string{};
 }
 
 SystemD::UnitInfo SystemD::unitNew(const std::string& name,
@@ -948,43 +1508,61 @@ SystemD::UnitInfo SystemD::unitNew(const std::string& name,
     {
         throw std::runtime_error{"Duplicate unit, not really new"};
     }
+    unitPathsAccount_->added(unitFootprint(info, *data));
+
+    /* We need the path to match property changes to the unit, but the
+       events for the unit don't need it, so they aren't held up waiting
+       on systemd. Anyone asking for it before the reply comes back
+       looks it up themselves. */
+    g_dbus_connection_call(bus.get(),                          /* user bus */
+                           SYSTEMD_DBUS_ADDRESS,               /* bus name */
+                           SYSTEMD_DBUS_PATH_MANAGER,          /* path */
+                           SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
+                           "GetUnit",                          /* method */
+                           g_variant_new("(s)", name.c_str()), /* params */
+                           G_VARIANT_TYPE("(o)"),              /* ret type */
+                           G_DBUS_CALL_FLAGS_NONE,             /* flags */
+                           -1,                                 /* timeout */
+                           reg->thread.getCancellable().get(), /* cancellable */
+                           [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+                               auto data = std::unique_ptr<std::shared_ptr<UnitData>>(
+                                   static_cast<std::shared_ptr<UnitData>*>(user_data));
+                               GError* error{nullptr};
+
+                               auto call =
+                                   unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
 
-    /* We need to get the path, we're blocking everyone else on
-       this call if they try to get the path. But we're just locking
-       up the UAL thread so it should be a big deal. But if someone
-       comes an asking at this point we'll think that we have the
-       app, but not yet its path */
-    GError* error{nullptr};
-    auto call = unique_glib(g_dbus_connection_call_sync(bus.get(),                          /* user bus */
-                                                        SYSTEMD_DBUS_ADDRESS,               /* bus name */
-                                                        SYSTEMD_DBUS_PATH_MANAGER,          /* path */
-                                                        SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
-                                                        "GetUnit",                          /* method */
-                                                        g_variant_new("(s)", name.c_str()), /* params */
-                                                        G_VARIANT_TYPE("(o)"),              /* ret type */
-                                                        G_DBUS_CALL_FLAGS_NONE,             /* flags */
-                                                        -1,                                 /* timeout */
-                                                        reg->thread.getCancellable().get(), /* cancellable */
-                                                        &error));
-
-    if (error != nullptr)
-    {
-        std::string message = "Unable to get SystemD unit path for '" + name + "': " + error->message;
-        g_error_free(error);
-        throw std::runtime_error{message};
-    }
-
-    /* Parse variant */
-    gchar* gpath{nullptr};
-    g_variant_get(call.get(), "(&o)", &gpath);
-    if (gpath)
-    {
-        data->unitpath = gpath;
-    }
+                               if (error != nullptr)
+                               {
+                                   if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                                   {
+                                       g_warning("Unable to get SystemD unit path: %s", error->message);
+                                   }
+                                   g_error_free(error);
+                                   return;
+                               }
+
+                               const gchar* gpath{nullptr};
+                               g_variant_get(call.get(), "(&o)", &gpath);
+                               if (gpath != nullptr && (*data)->unitpath.empty())
+                               {
+                                   (*data)->unitpath = gpath;
+                               }
+                           },
+                           new std::shared_ptr<UnitData>(data));
 
     return info;
 }
 
+/** Estimate of the memory used by an entry in unitPaths. The unit path
+    is left out as it is filled in after the entry is added, it is about
+    the same size as the job path. */
+std::size_t SystemD::unitFootprint(const UnitInfo& info, const UnitData& data)
+{
+    return sizeof(UnitInfo) + sizeof(UnitData) + info.appid.size() + info.job.size() + info.inst.size() +
+           2 * data.jobpath.size();
+}
+
 void SystemD::unitRemoved(const std::string& name, const std::string& path)
 {
     UnitInfo info = parseUnit(name);
@@ -992,9 +1570,43 @@ void SystemD::unitRemoved(const std::string& name, const std::string& path)
     auto it = unitPaths.find(info);
     if (it != unitPaths.end())
     {
+        unitPathsAccount_->removed(unitFootprint(it->first, *it->second));
         unitPaths.erase(it);
         sig_jobStopped(info.job, info.appid, info.inst);
     }
+
+    /* Forget it if it was retired and the stop wasn't reported, which
+       happens for ones other processes retired that we weren't tracking */
+    instanceRetired(info.appid, info.inst);
+
+    dropBoost(name);
+
+    std::list<std::shared_ptr<StartCHelper>> starts;
+    auto pending = pendingStarts_.find(name);
+    if (pending != pendingStarts_.end())
+    {
+        starts = pending->second;
+        pendingStarts_.erase(pending);
+    }
+
+    /* Clean up the image if we restored from one. A new instance that
+       claimed an image has already replaced it with its own. */
+    bool claimed = std::any_of(starts.begin(), starts.end(),
+                               [](const std::shared_ptr<StartCHelper>& start) { return bool(start->restoring); });
+    auto checkpointer = getReg()->getCheckpointer();
+    if (checkpointer && !claimed)
+    {
+        checkpointer->restoreFinished(name);
+    }
+
+    /* Start anyone who was waiting on this unit to go away */
+    auto reg = getReg();
+    for (const auto& start : starts)
+    {
+        reg->thread.removeSource(start->timeout);
+        start->timeout = 0;
+        startTransientUnit(new StartCHelper(*start));
+    }
 }
 
 pid_t SystemD::unitPrimaryPid(const AppID& appId, const std::string& job, const std::string& instance)
@@ -1148,9 +1760,58 @@ void SystemD::stopUnit(const AppID& appId, const std::string& job, const std::st
 {
     auto unitname = unitName(SystemD::UnitInfo{appId, job, instance});
     auto reg = getReg();
+    bool helper = std::find(allApplicationJobs_.begin(), allApplicationJobs_.end(), job) == allApplicationJobs_.end();
 
-    reg->thread.executeOnThread<bool>([this, unitname, reg] {
+    reg->thread.executeOnThread<bool>([this, unitname, reg, helper] {
         GError* error{nullptr};
+
+        /* Activated helpers need their socket stopped first so that it
+           doesn't start them again. They could have been activated by
+           another process, so we don't know whether there is a socket,
+           but systemd handles our calls in order so we can just ask. */
+        if (helper)
+        {
+            auto socketname = activationSocketName(unitname);
+            g_dbus_connection_call(userbus_.get(),                        /* user bus */
+                                   SYSTEMD_DBUS_ADDRESS,                  /* bus name */
+                                   SYSTEMD_DBUS_PATH_MANAGER,             /* path */
+                                   SYSTEMD_DBUS_IFACE_MANAGER,            /* interface */
+                                   "StopUnit",                            /* method */
+                                   g_variant_new("(ss)",                  /* params */
+                                                 socketname.c_str(),      /* param: specify unit */
+                                                 "replace-irreversibly"), /* param: job mode */
+                                   G_VARIANT_TYPE("(o)"),                 /* ret type */
+                                   G_DBUS_CALL_FLAGS_NONE,                /* flags */
+                                   -1,                                    /* timeout */
+                                   reg->thread.getCancellable().get(),    /* cancellable */
+                                   [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+                                       GError* error{nullptr};
+                                       unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
+
+                                       if (error == nullptr)
+                                       {
+                                           return;
+                                       }
+
+                                       /* Not activated, nothing to stop */
+                                       gchar* remote_error{nullptr};
+                                       if (g_dbus_error_is_remote_error(error))
+                                       {
+                                           remote_error = g_dbus_error_get_remote_error(error);
+                                       }
+
+                                       if (g_strcmp0(remote_error, "org.freedesktop.systemd1.NoSuchUnit") != 0 &&
+                                           !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                                       {
+                                           g_debug("Unable to stop socket unit: %s", error->message);
+                                       }
+
+                                       g_free(remote_error);
+                                       g_error_free(error);
+                                   },
+                                   nullptr);
+        }
+
         unique_glib(g_dbus_connection_call_sync(
             userbus_.get(),             /* user bus */
             SYSTEMD_DBUS_ADDRESS,       /* bus name */
@@ -1179,6 +1840,429 @@ void SystemD::stopUnit(const AppID& appId, const std::string& job, const std::st
     });
 }
 
+/** Stops an instance we're retiring without waiting for systemd, so
+    that the registry thread isn't held up. If systemd won't stop it we
+    forget that we're retiring it. Only called on the registry thread. */
+void SystemD::retireInstance(const AppID& appId, const std::string& job, const std::string& instance)
+{
+    struct RetireData
+    {
+        std::weak_ptr<Registry::Impl> weakReg;
+        std::string appid;
+        std::string instance;
+    };
+
+    auto unitname = unitName(SystemD::UnitInfo{appId, job, instance});
+    auto reg = getReg();
+    auto data = new RetireData{reg, std::string(appId), instance};
+
+    g_dbus_connection_call(userbus_.get(),                        /* user bus */
+                           SYSTEMD_DBUS_ADDRESS,                  /* bus name */
+                           SYSTEMD_DBUS_PATH_MANAGER,             /* path */
+                           SYSTEMD_DBUS_IFACE_MANAGER,            /* interface */
+                           "StopUnit",                            /* method */
+                           g_variant_new("(ss)",                  /* params */
+                                         unitname.c_str(),        /* param: specify unit */
+                                         "replace-irreversibly"), /* param: job mode */
+                           G_VARIANT_TYPE("(o)"),                 /* ret type */
+                           G_DBUS_CALL_FLAGS_NONE,                /* flags */
+                           -1,                                    /* timeout */
+                           reg->thread.getCancellable().get(),    /* cancellable */
+                           [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+                               auto data = static_cast<RetireData*>(user_data);
+                               GError* error{nullptr};
+                               unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
+
+                               if (error != nullptr)
+                               {
+                                   if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                                   {
+                                       g_warning("Unable to retire instance '%s' of '%s': %s", data->instance.c_str(),
+                                                 data->appid.c_str(), error->message);
+
+                                       auto reg = data->weakReg.lock();
+                                       if (reg)
+                                       {
+                                           auto manager = std::dynamic_pointer_cast<SystemD>(reg->jobs());
+                                           manager->instanceRetired(data->appid, data->instance);
+                                       }
+                                   }
+                                   g_error_free(error);
+                               }
+
+                               delete data;
+                           },
+                           data);
+}
+
+/** Called when the application has shown that it is up and running,
+    drops it back to the normal weights if it was boosted. */
+void SystemD::unitReady(const AppID& appId, const std::string& job, const std::string& instance)
+{
+    auto unitname = unitName(SystemD::UnitInfo{appId, job, instance});
+    auto reg = getReg();
+    std::weak_ptr<Registry::Impl> weakReg = reg;
+
+    reg->thread.executeOnThread([weakReg, unitname] {
+        auto reg = weakReg.lock();
+        if (!reg)
+        {
+            return;
+        }
+
+        auto manager = std::dynamic_pointer_cast<SystemD>(reg->jobs());
+        manager->endBoost(unitname, "ready");
+    });
+}
+
+/** Whether we're configured to boost launching applications, it needs
+    to be turned on with UBUNTU_APP_LAUNCH_SYSTEMD_BOOST */
+bool SystemD::boostEnabled() const
+{
+    return boostLaunches_ && (boostCpuWeight_ != 0 || boostIoWeight_ != 0);
+}
+
+/** Adds the boosted weights to the properties of a new unit
+
+    \param builder Builder that is in the middle of the a(sv) property array
+*/
+void SystemD::addBoostProperties(GVariantBuilder* builder) const
+{
+    if (boostCpuWeight_ != 0)
+    {
+        g_variant_builder_add(builder, "(sv)", "CPUWeight", g_variant_new_uint64(boostCpuWeight_));
+    }
+    if (boostIoWeight_ != 0)
+    {
+        g_variant_builder_add(builder, "(sv)", "IOWeight", g_variant_new_uint64(boostIoWeight_));
+    }
+}
+
+/** Start tracking a unit that we started with the boost so that we can
+    lower it once the application is ready, or when we run out of patience.
+    Only the process that launched it tracks it, other processes can't tell
+    a boosted unit from one whose weights were set by someone else.
+
+    \param unitname Name of the unit that was started
+    \param appid Application ID for reporting
+*/
+void SystemD::startBoost(const std::string& unitname, const std::string& appid)
+{
+    if (boosts_.find(unitname) != boosts_.end())
+    {
+        return;
+    }
+
+    auto reg = getReg();
+
+    BoostData data{appid, 0, std::chrono::steady_clock::now()};
+
+    if (boostTimeout_.count() > 0)
+    {
+        std::weak_ptr<Registry::Impl> weakReg = reg;
+        data.timeout = reg->thread.timeout(boostTimeout_, [weakReg, unitname]() {
+            auto reg = weakReg.lock();
+            if (!reg)
+            {
+                return;
+            }
+
+            auto manager = std::dynamic_pointer_cast<SystemD>(reg->jobs());
+            manager->endBoost(unitname, "timeout");
+        });
+    }
+
+    boosts_[unitname] = data;
+
+    tracepoint(ubuntu_app_launch, libual_boost_start, appid.c_str(), int(boostCpuWeight_), int(boostIoWeight_));
+    g_debug("Boosting unit '%s' while it starts: CPUWeight=%d IOWeight=%d", unitname.c_str(), int(boostCpuWeight_),
+            int(boostIoWeight_));
+}
+
+/** Stops tracking a boosted unit and lowers it back to the normal weights.
+
+    \param unitname Name of the boosted unit
+    \param reason Why the boost is ending, for reporting
+*/
+void SystemD::endBoost(const std::string& unitname, const std::string& reason)
+{
+    auto it = boosts_.find(unitname);
+    if (it == boosts_.end())
+    {
+        return;
+    }
+
+    auto reg = getReg();
+    if (it->second.timeout != 0)
+    {
+        reg->thread.removeSource(it->second.timeout);
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                          it->second.start);
+    tracepoint(ubuntu_app_launch, libual_boost_end, it->second.appid.c_str(), reason.c_str(), int(duration.count()));
+    g_debug("Ending boost for unit '%s' after %d ms: %s", unitname.c_str(), int(duration.count()), reason.c_str());
+
+    boosts_.erase(it);
+
+    g_dbus_connection_call(userbus_.get(),                     /* user bus */
+                           SYSTEMD_DBUS_ADDRESS,               /* bus name */
+                           SYSTEMD_DBUS_PATH_MANAGER,          /* path */
+                           SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
+                           "SetUnitProperties",                /* method */
+                           normalWeightsParams(unitname),      /* params */
+                           nullptr,                            /* ret type */
+                           G_DBUS_CALL_FLAGS_NONE,             /* flags */
+                           -1,                                 /* timeout */
+                           reg->thread.getCancellable().get(), /* cancellable */
+                           [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+                               GError* error{nullptr};
+                               unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
+
+                               if (error != nullptr)
+                               {
+                                   /* Most likely the unit exited already */
+                                   if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                                   {
+                                       g_debug("Unable to lower unit weights: %s", error->message);
+                                   }
+                                   g_error_free(error);
+                                   return;
+                               }
+
+                               g_debug("Lowered unit weights");
+                           },
+                           nullptr);
+}
+
+/** Parameters for SetUnitProperties that put a unit back to the normal
+    weights. This is a runtime change so that systemd doesn't keep it
+    around after the unit is gone.
+
+    \param unitname Name of the boosted unit
+*/
+GVariant* SystemD::normalWeightsParams(const std::string& unitname) const
+{
+    GVariantBuilder props;
+    g_variant_builder_init(&props, G_VARIANT_TYPE("a(sv)"));
+    if (boostCpuWeight_ != 0)
+    {
+        g_variant_builder_add(&props, "(sv)", "CPUWeight", g_variant_new_uint64(NORMAL_WEIGHT));
+    }
+    if (boostIoWeight_ != 0)
+    {
+        g_variant_builder_add(&props, "(sv)", "IOWeight", g_variant_new_uint64(NORMAL_WEIGHT));
+    }
+
+    return g_variant_new("(sba(sv))", unitname.c_str(), TRUE, &props);
+}
+
+/** Forget about the boost on a unit without telling systemd, used
+    when the unit is already gone.
+
+    \param unitname Name of the unit
+*/
+void SystemD::dropBoost(const std::string& unitname)
+{
+    auto it = boosts_.find(unitname);
+    if (it == boosts_.end())
+    {
+        return;
+    }
+
+    if (it->second.timeout != 0)
+    {
+        getReg()->thread.removeSource(it->second.timeout);
+    }
+    boosts_.erase(it);
+}
+
+/** Name of the socket unit that activates a service unit */
+std::string SystemD::activationSocketName(const std::string& unitname)
+{
+    static const std::string suffix{".service"};
+    if (unitname.size() <= suffix.size() ||
+        unitname.compare(unitname.size() - suffix.size(), suffix.size(), suffix) != 0)
+    {
+        throw std::runtime_error{"Unable to make an activation socket for unit that isn't a service: " + unitname};
+    }
+
+    return unitname.substr(0, unitname.size() - suffix.size()) + ".socket";
+}
+
+/** Name of the service unit held by one of our activation socket units,
+    empty if the unit isn't one of them */
+std::string SystemD::activationServiceName(const std::string& socketname)
+{
+    static const std::string prefix{"ubuntu-app-launch--"};
+    static const std::string suffix{".socket"};
+    if (socketname.size() <= prefix.size() + suffix.size() || socketname.compare(0, prefix.size(), prefix) != 0 ||
+        socketname.compare(socketname.size() - suffix.size(), suffix.size(), suffix) != 0)
+    {
+        return {};
+    }
+
+    return socketname.substr(0, socketname.size() - suffix.size()) + ".service";
+}
+
+/** Path of the socket used to hold a unit that only has D-Bus names.
+    Socket paths are limited in length so we use a hash of the unit name. */
+std::string SystemD::activationHolderPath(const std::string& unitname)
+{
+    auto hash = unique_gchar(g_compute_checksum_for_string(G_CHECKSUM_MD5, unitname.c_str(), -1));
+    return std::string{g_get_user_runtime_dir()} + "/ubuntu-app-launch/activate-" + hash.get();
+}
+
+/** Directory where the session bus looks for service files */
+std::string SystemD::busServicesDir()
+{
+    auto cdir = getenv("UBUNTU_APP_LAUNCH_DBUS_SERVICES_DIR");
+    if (cdir != nullptr)
+    {
+        return cdir;
+    }
+
+    return std::string{g_get_user_runtime_dir()} + "/dbus-1/services";
+}
+
+/** Builds the StartTransientUnit parameters for a socket unit that has
+    the service as an auxiliary unit, and writes D-Bus service files for
+    any names the helper has. systemd only keeps the service unit loaded
+    while something refers to it, so helpers that only have D-Bus names
+    get a private socket to hold on to it.
+
+    \param unitname Name of the service unit
+    \param serviceprops Properties of the service unit, floating refs are sunk
+    \param endpoints What can start the helper
+*/
+GVariant* SystemD::activationParams(const std::string& unitname,
+                                    GVariant* serviceprops,
+                                    const std::vector<Helper::Endpoint>& endpoints)
+{
+    auto socketname = activationSocketName(unitname);
+    bool busfiles{false};
+
+    GVariantBuilder listen;
+    g_variant_builder_init(&listen, G_VARIANT_TYPE("a(ss)"));
+    bool hasSocket{false};
+
+    for (const auto& endpoint : endpoints)
+    {
+        if (endpoint.kind == Helper::Endpoint::Kind::SOCKET)
+        {
+            g_variant_builder_add(&listen, "(ss)", "Stream", endpoint.address.c_str());
+            hasSocket = true;
+            continue;
+        }
+
+        auto dir = busServicesDir();
+        g_mkdir_with_parents(dir.c_str(), 0700);
+
+        auto path = dir + "/" + endpoint.address + ".service";
+        auto contents = "[D-BUS Service]\nName=" + endpoint.address + "\nExec=/bin/false\nSystemdService=" +
+                        unitname + "\n";
+
+        GError* error{nullptr};
+        g_file_set_contents(path.c_str(), contents.c_str(), -1, &error);
+        if (error != nullptr)
+        {
+            g_warning("Unable to write D-Bus service file '%s': %s", path.c_str(), error->message);
+            g_error_free(error);
+            continue;
+        }
+
+        busfiles = true;
+    }
+
+    if (!hasSocket)
+    {
+        g_variant_builder_add(&listen, "(ss)", "Stream", activationHolderPath(unitname).c_str());
+    }
+
+    if (busfiles)
+    {
+        /* Make sure the bus sees the new names */
+        g_dbus_connection_call(userbus_.get(),                          /* user bus */
+                               "org.freedesktop.DBus",                  /* bus name */
+                               "/org/freedesktop/DBus",                 /* path */
+                               "org.freedesktop.DBus",                  /* interface */
+                               "ReloadConfig",                          /* method */
+                               nullptr,                                 /* params */
+                               nullptr,                                 /* ret type */
+                               G_DBUS_CALL_FLAGS_NONE,                  /* flags */
+                               -1,                                      /* timeout */
+                               getReg()->thread.getCancellable().get(), /* cancellable */
+                               [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+                                   GError* error{nullptr};
+                                   unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
+
+                                   if (error != nullptr)
+                                   {
+                                       if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                                       {
+                                           g_debug("Unable to reload the bus config: %s", error->message);
+                                       }
+                                       g_error_free(error);
+                                   }
+                               },
+                               nullptr);
+    }
+
+    GVariantBuilder socketprops;
+    g_variant_builder_init(&socketprops, G_VARIANT_TYPE("a(sv)"));
+    g_variant_builder_add(&socketprops, "(sv)", "Listen", g_variant_builder_end(&listen));
+    g_variant_builder_add(&socketprops, "(sv)", "RemoveOnStop", g_variant_new_boolean(TRUE));
+
+    GVariantBuilder aux;
+    g_variant_builder_init(&aux, G_VARIANT_TYPE("a(sa(sv))"));
+    g_variant_builder_add(&aux, "(s@a(sv))", unitname.c_str(), serviceprops);
+
+    g_debug("Waiting to start unit '%s' with socket '%s'", unitname.c_str(), socketname.c_str());
+
+    return g_variant_new("(ssa(sv)a(sa(sv)))", socketname.c_str(), "replace", &socketprops, &aux);
+}
+
+/** Cleans up the D-Bus service files that point at a unit once its
+    socket is gone. Whoever sees the socket go away does this, so we
+    find the files by the unit they point at.
+
+    \param unitname Name of the service unit
+*/
+void SystemD::removeActivation(const std::string& unitname)
+{
+    auto dirname = busServicesDir();
+    auto dir = g_dir_open(dirname.c_str(), 0, nullptr);
+    if (dir == nullptr)
+    {
+        return;
+    }
+
+    const gchar* filename{nullptr};
+    while ((filename = g_dir_read_name(dir)) != nullptr)
+    {
+        if (!g_str_has_suffix(filename, ".service"))
+        {
+            continue;
+        }
+
+        auto path = dirname + "/" + filename;
+        auto keyfile = unique_glib(g_key_file_new());
+        if (!g_key_file_load_from_file(keyfile.get(), path.c_str(), G_KEY_FILE_NONE, nullptr))
+        {
+            continue;
+        }
+
+        auto service = unique_gchar(g_key_file_get_string(keyfile.get(), "D-BUS Service", "SystemdService", nullptr));
+        if (service && unitname == service.get())
+        {
+            g_debug("Removing D-Bus service file '%s' for unit '%s'", path.c_str(), unitname.c_str());
+            g_unlink(path.c_str());
+        }
+    }
+
+    g_dir_close(dir);
+}
+
 core::Signal<const std::string&, const std::string&, const std::string&>& SystemD::jobStarted()
 {
     /* Ensure we're connecting to the signals */
@@ -1197,6 +2281,15 @@ struct FailedData
 };
 
 core::Signal<const std::string&, const std::string&, const std::string&, Registry::FailureType>& SystemD::jobFailed()
+{
+    watchFailures();
+    return sig_jobFailed;
+}
+
+/** Subscribes to the Result property changes on our units so that
+    failures get reported on the jobFailed signal. Safe to call more
+    than once, we only subscribe the first time. */
+void SystemD::watchFailures()
 {
     std::call_once(flag_appFailed, [this]() {
         auto reg = getReg();
@@ -1286,8 +2379,6 @@ core::Signal<const std::string&, const std::string&, const std::string&, Registr
             return true;
         });
     });
-
-    return sig_jobFailed;
 }
 
 /** Requests that systemd reset a unit that has been marked as
@@ -20,7 +20,9 @@
 #pragma once
 
 #include "jobs-base.h"
+#include "memory-budget.h"
 #include <chrono>
+#include <cstdint>
 #include <future>
 #include <gio/gio.h>
 #include <map>
@@ -38,6 +40,8 @@ namespace jobs
 namespace manager
 {
 
+struct StartCHelper;
+
 class SystemD : public Base
 {
 public:
@@ -51,6 +55,13 @@ public:
         const std::vector<Application::URL>& urls,
         launchMode mode,
         std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv) override;
+    virtual std::shared_ptr<Application::Instance> activate(
+        const AppID& appId,
+        const std::string& job,
+        const std::string& instance,
+        const std::vector<Application::URL>& urls,
+        const std::vector<Helper::Endpoint>& endpoints,
+        std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv) override;
     virtual std::shared_ptr<Application::Instance> existing(const AppID& appId,
                                                             const std::string& job,
                                                             const std::string& instance,
@@ -70,6 +81,10 @@ public:
     pid_t unitPrimaryPid(const AppID& appId, const std::string& job, const std::string& instance);
     std::vector<pid_t> unitPids(const AppID& appId, const std::string& job, const std::string& instance);
     void stopUnit(const AppID& appId, const std::string& job, const std::string& instance);
+    void unitReady(const AppID& appId, const std::string& job, const std::string& instance);
+
+protected:
+    virtual void retireInstance(const AppID& appId, const std::string& job, const std::string& instance) override;
 
 private:
     std::string cgroup_root_;
@@ -89,6 +104,30 @@ private:
 
     bool noResetUnits_{false}; /**< Debug flag to avoid resetting the systemd units */
 
+    std::size_t urisFileThreshold_; /**< Size of the URL list above which we pass it in a file */
+
+    std::chrono::milliseconds relaunchTimeout_; /**< How long we wait for a dying unit to go away */
+
+    bool boostLaunches_{false};              /**< Whether applications we launch get boosted */
+    std::uint64_t boostCpuWeight_;           /**< CPUWeight for units that are starting, zero for no boost */
+    std::uint64_t boostIoWeight_;            /**< IOWeight for units that are starting, zero for no boost */
+    std::chrono::milliseconds boostTimeout_; /**< Longest we'll keep a unit boosted if it doesn't get ready */
+
+    /** A unit that is running with the launch boost */
+    struct BoostData
+    {
+        std::string appid;                           /**< Application the unit is for */
+        guint timeout;                               /**< Source that ends the boost if the app never gets ready */
+        std::chrono::steady_clock::time_point start; /**< When the boost was given */
+    };
+    /** Units that we boosted, indexed by the unit name. Only used on
+        the registry thread. */
+    std::map<std::string, BoostData> boosts_;
+
+    /** Launches that are waiting for the previous unit with the same name
+        to go away, indexed by the unit name */
+    std::map<std::string, std::list<std::shared_ptr<StartCHelper>>> pendingStarts_;
+
     std::once_flag
         flag_appFailed; /**< Variable to track to see if signal handlers are installed for application failed */
 
@@ -119,9 +158,13 @@ private:
     };
 
     std::map<UnitInfo, std::shared_ptr<UnitData>> unitPaths;
+    /** Memory used by unitPaths, counted against the registry's budget */
+    std::shared_ptr<MemoryAccount> unitPathsAccount_;
+    static std::size_t unitFootprint(const UnitInfo& info, const UnitData& data);
     UnitInfo parseUnit(const std::string& unit) const;
     std::string unitName(const UnitInfo& info) const;
     std::string unitPath(const UnitInfo& info);
+    std::string getUnitPath(const std::string& name);
 
     UnitInfo unitNew(const std::string& name, const std::string& path, const std::shared_ptr<GDBusConnection>& bus);
     void unitRemoved(const std::string& name, const std::string& path);
@@ -132,10 +175,42 @@ private:
     static void copyEnvByPrefix(const std::string& prefix, std::list<std::pair<std::string, std::string>>& env);
     static int envSize(std::list<std::pair<std::string, std::string>>& env);
 
-    static std::vector<std::string> parseExec(std::list<std::pair<std::string, std::string>>& env);
+    static std::vector<std::string> parseExec(std::list<std::pair<std::string, std::string>>& env,
+                                              const std::vector<Application::URL>& urls);
+    static std::size_t urlsSize(const std::vector<Application::URL>& urls);
+    static std::string writeUrisFile(const std::string& unitname, const std::vector<Application::URL>& urls);
     static void application_start_cb(GObject* obj, GAsyncResult* res, gpointer user_data);
 
+    std::shared_ptr<Application::Instance> startUnit(
+        const AppID& appId,
+        const std::string& job,
+        const std::string& instance,
+        const std::vector<Application::URL>& urls,
+        launchMode mode,
+        const std::vector<Helper::Endpoint>& endpoints,
+        std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv);
+    void startTransientUnit(StartCHelper* data);
+    void unitActiveState(const std::string& unitname, const std::function<void(const std::string&)>& callback);
+    void startAfterUnit(StartCHelper* data, const std::string& state);
+
     void resetUnit(const UnitInfo& info);
+    void watchFailures();
+
+    bool boostEnabled() const;
+    void addBoostProperties(GVariantBuilder* builder) const;
+    void startBoost(const std::string& unitname, const std::string& appid);
+    void endBoost(const std::string& unitname, const std::string& reason);
+    GVariant* normalWeightsParams(const std::string& unitname) const;
+    void dropBoost(const std::string& unitname);
+
+    static std::string activationSocketName(const std::string& unitname);
+    static std::string activationServiceName(const std::string& socketname);
+    static std::string activationHolderPath(const std::string& unitname);
+    static std::string busServicesDir();
+    GVariant* activationParams(const std::string& unitname,
+                               GVariant* serviceprops,
+                               const std::vector<Helper::Endpoint>& endpoints);
+    void removeActivation(const std::string& unitname);
 };
 
 }  // namespace manager
@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "memory-budget.h"
+
+#include <functional>
+#include <list>
+#include <map>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** A cache of values that are expensive to build but can be built again,
+    which lets the memory budget drop the ones that haven't been used in
+    a while. It is safe to use from any thread. */
+template <typename Key, typename Value>
+class LruCache : public MemoryBudget::Cache
+{
+public:
+    /** Function to estimate the number of bytes used by an entry */
+    typedef std::function<std::size_t(const Key&, const Value&)> SizeFunc;
+
+    LruCache(const std::string& name, const std::shared_ptr<MemoryBudget>& budget, SizeFunc size)
+        : MemoryBudget::Cache(name, budget)
+        , size_(size)
+        , bytes_(0)
+    {
+        registerCache();
+    }
+
+    virtual ~LruCache()
+    {
+        unregister();
+    }
+
+    /** Look up @key, calling @create to build the value if it isn't
+        in the cache. Building is done without the lock held so that
+        slow builds don't block other lookups. */
+    Value get(const Key& key, std::function<Value()> create)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            auto it = entries_.find(key);
+            if (it != entries_.end())
+            {
+                hits_++;
+                it->second.lastUsed = budget_->tick();
+                lru_.splice(lru_.begin(), lru_, it->second.position);
+                return it->second.value;
+            }
+            misses_++;
+        }
+
+        auto value = create();
+        auto size = size_(key, value);
+        auto used = budget_->tick();
+
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            auto it = entries_.find(key);
+            if (it != entries_.end())
+            {
+                /* Someone else built it while we were */
+                return it->second.value;
+            }
+
+            lru_.push_front(key);
+            entries_.emplace(key, Entry{value, size, used, lru_.begin()});
+            bytes_ += size;
+        }
+
+        budget_->enforce(used);
+        return value;
+    }
+
+    /** Drop everything in the cache */
+    void clear()
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        entries_.clear();
+        lru_.clear();
+        bytes_ = 0;
+    }
+
+    std::size_t entries() override
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        return entries_.size();
+    }
+
+    std::size_t footprint() override
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        return bytes_;
+    }
+
+    std::uint64_t oldest() override
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (lru_.empty())
+        {
+            return 0;
+        }
+        return entries_.at(lru_.back()).lastUsed;
+    }
+
+    void evictOldest() override
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (lru_.empty())
+        {
+            return;
+        }
+
+        auto it = entries_.find(lru_.back());
+        bytes_ -= it->second.size;
+        entries_.erase(it);
+        lru_.pop_back();
+        evictions_++;
+    }
+
+private:
+    /** A value along with its bookkeeping */
+    struct Entry
+    {
+        Value value;                                /**< The cached value */
+        std::size_t size;                           /**< Estimated bytes used */
+        std::uint64_t lastUsed;                     /**< Budget tick when last used */
+        typename std::list<Key>::iterator position; /**< Where we are in the LRU list */
+    };
+
+    /** Protects all the entries */
+    std::mutex lock_;
+    /** Size estimating function */
+    SizeFunc size_;
+    /** Entries in the cache */
+    std::map<Key, Entry> entries_;
+    /** Keys with the most recently used at the front */
+    std::list<Key> lru_;
+    /** Total of the entry sizes */
+    std::size_t bytes_;
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
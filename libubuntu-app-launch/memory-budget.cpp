@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "memory-budget.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <glib.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** Default cap on the registry's caches, in bytes */
+static const std::size_t MEMORY_BUDGET_DEFAULT{4 * 1024 * 1024};
+
+MemoryBudget::Cache::Cache(const std::string& name, const std::shared_ptr<MemoryBudget>& budget)
+    : budget_(budget)
+    , hits_(0)
+    , misses_(0)
+    , evictions_(0)
+    , name_(name)
+    , registered_(false)
+{
+}
+
+MemoryBudget::Cache::~Cache()
+{
+    unregister();
+}
+
+/** Put the cache on the budget. Subclasses call this at the end of their
+    constructor, and unregister() at the start of their destructor, so that
+    the budget never calls into a cache that is partially built. */
+void MemoryBudget::Cache::registerCache()
+{
+    if (!registered_)
+    {
+        budget_->add(this);
+        registered_ = true;
+    }
+}
+
+void MemoryBudget::Cache::unregister()
+{
+    if (registered_)
+    {
+        budget_->remove(this);
+        registered_ = false;
+    }
+}
+
+/** Statistics for this cache */
+Registry::CacheStats MemoryBudget::Cache::stats()
+{
+    return {name_, entries(), footprint(), hits_, misses_, evictions_};
+}
+
+MemoryBudget::MemoryBudget()
+    : cap_(MEMORY_BUDGET_DEFAULT)
+    , tick_(0)
+{
+    auto envcap = getenv("UBUNTU_APP_LAUNCH_MEMORY_BUDGET");
+    if (envcap != nullptr)
+    {
+        cap_ = std::strtoull(envcap, nullptr, 10);
+    }
+}
+
+std::size_t MemoryBudget::cap()
+{
+    return cap_;
+}
+
+/** Change the cap, evicting right away if we're now over it */
+void MemoryBudget::setCap(std::size_t cap)
+{
+    cap_ = cap;
+    enforce();
+}
+
+/** Total of the footprints of all the caches */
+std::size_t MemoryBudget::used()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    std::size_t total{0};
+    for (const auto& cache : caches_)
+    {
+        total += cache->footprint();
+    }
+    return total;
+}
+
+std::list<Registry::CacheStats> MemoryBudget::stats()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    std::list<Registry::CacheStats> retval;
+    for (const auto& cache : caches_)
+    {
+        retval.push_back(cache->stats());
+    }
+    return retval;
+}
+
+/** Evict the least recently used entries until we're under the cap. Caches
+    must not be holding their own locks when calling this as we call back
+    into them. The entry used at @keep is never evicted, so that an entry
+    that was just built survives even if it is larger than the cap. */
+void MemoryBudget::enforce(std::uint64_t keep)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if (cap_ == 0)
+    {
+        return;
+    }
+
+    while (true)
+    {
+        std::size_t total{0};
+        Cache* victim{nullptr};
+        std::uint64_t victimTick{0};
+
+        for (const auto& cache : caches_)
+        {
+            total += cache->footprint();
+
+            auto oldest = cache->oldest();
+            if (oldest != 0 && oldest != keep && (victim == nullptr || oldest < victimTick))
+            {
+                victim = cache;
+                victimTick = oldest;
+            }
+        }
+
+        if (total <= cap_)
+        {
+            return;
+        }
+
+        if (victim == nullptr)
+        {
+            g_debug("Caches are using %d bytes, over the budget of %d, but nothing can be evicted", int(total),
+                    int(cap_));
+            return;
+        }
+
+        victim->evictOldest();
+    }
+}
+
+/** Get a new value to mark an entry as used. It is shared between the
+    caches so that we can compare entries from different ones. */
+std::uint64_t MemoryBudget::tick()
+{
+    return ++tick_;
+}
+
+void MemoryBudget::add(Cache* cache)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    caches_.push_back(cache);
+}
+
+void MemoryBudget::remove(Cache* cache)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    caches_.remove(cache);
+}
+
+MemoryAccount::MemoryAccount(const std::string& name, const std::shared_ptr<MemoryBudget>& budget)
+    : MemoryBudget::Cache(name, budget)
+    , entries_(0)
+    , bytes_(0)
+{
+    registerCache();
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    unregister();
+}
+
+/** An entry was added, which could push out entries in other caches */
+void MemoryAccount::added(std::size_t bytes)
+{
+    entries_++;
+    bytes_ += bytes;
+    budget_->enforce();
+}
+
+void MemoryAccount::removed(std::size_t bytes)
+{
+    entries_--;
+    bytes_ -= bytes;
+}
+
+void MemoryAccount::hit()
+{
+    hits_++;
+}
+
+void MemoryAccount::miss()
+{
+    misses_++;
+}
+
+std::size_t MemoryAccount::entries()
+{
+    return entries_;
+}
+
+std::size_t MemoryAccount::footprint()
+{
+    return bytes_;
+}
+
+/** Nothing here can be evicted */
+std::uint64_t MemoryAccount::oldest()
+{
+    return 0;
+}
+
+void MemoryAccount::evictOldest()
+{
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,135 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "registry.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** A cap on the memory used by the long lived caches in a registry.
+    Caches register with the budget and report their approximate size,
+    when the total is over the cap the least recently used entry across
+    all the caches is evicted until we're back under it. Caches that hold
+    state that can't be thrown away are only counted. */
+class MemoryBudget
+{
+public:
+    /** Base for anything that holds memory for the registry */
+    class Cache
+    {
+    public:
+        Cache(const std::string& name, const std::shared_ptr<MemoryBudget>& budget);
+        virtual ~Cache();
+
+        Registry::CacheStats stats();
+
+        /** Number of entries in the cache */
+        virtual std::size_t entries() = 0;
+        /** Approximate number of bytes used by the cache */
+        virtual std::size_t footprint() = 0;
+        /** When the least recently used entry that can be evicted was
+            last used, zero if nothing can be evicted */
+        virtual std::uint64_t oldest() = 0;
+        /** Drop the least recently used entry */
+        virtual void evictOldest() = 0;
+
+    protected:
+        /** Budget we're a part of */
+        std::shared_ptr<MemoryBudget> budget_;
+        /** Lookups that found an entry */
+        std::atomic<std::uint64_t> hits_;
+        /** Lookups that had to build an entry */
+        std::atomic<std::uint64_t> misses_;
+        /** Entries dropped to stay under the budget */
+        std::atomic<std::uint64_t> evictions_;
+
+        void registerCache();
+        void unregister();
+
+    private:
+        /** Name reported in the statistics */
+        std::string name_;
+        /** Whether we're still on the budget's list */
+        bool registered_;
+    };
+
+    MemoryBudget();
+    virtual ~MemoryBudget() = default;
+
+    std::size_t cap();
+    void setCap(std::size_t cap);
+    std::size_t used();
+    std::list<Registry::CacheStats> stats();
+
+    void enforce(std::uint64_t keep = 0);
+    std::uint64_t tick();
+
+private:
+    /** Protects the list of caches and makes sure only one thread
+        is evicting at a time */
+    std::mutex lock_;
+    /** All the registered caches */
+    std::list<Cache*> caches_;
+    /** Maximum bytes, zero for no limit */
+    std::atomic<std::size_t> cap_;
+    /** Counter used to order uses across caches */
+    std::atomic<std::uint64_t> tick_;
+
+    void add(Cache* cache);
+    void remove(Cache* cache);
+};
+
+/** Memory that counts against the budget but that can't be evicted.
+    The owner tells us as entries come and go. */
+class MemoryAccount : public MemoryBudget::Cache
+{
+public:
+    MemoryAccount(const std::string& name, const std::shared_ptr<MemoryBudget>& budget);
+    virtual ~MemoryAccount();
+
+    void added(std::size_t bytes);
+    void removed(std::size_t bytes);
+    void hit();
+    void miss();
+
+    std::size_t entries() override;
+    std::size_t footprint() override;
+    std::uint64_t oldest() override;
+    void evictOldest() override;
+
+private:
+    /** Number of entries the owner has */
+    std::atomic<std::size_t> entries_;
+    /** Bytes used by those entries */
+    std::atomic<std::size_t> bytes_;
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -20,6 +20,7 @@
 #include "registry-impl.h"
 #include "application-icon-finder.h"
 #include "application-impl-base.h"
+#include "checkpointer-criu.h"
 #include "helper-impl.h"
 #include <regex>
 #include <unity/util/GObjectMemory.h>
@@ -32,7 +33,10 @@ namespace ubuntu
 namespace app_launch
 {
 
-Registry::Impl::Impl()
+/** Sets up the shared resources for the registry. If @context is
+    set we won't create a thread and everything is done on that
+    context, which the caller is expected to be iterating. */
+Registry::Impl::Impl(const std::shared_ptr<GMainContext>& context)
     : thread([]() {},
              [this]() {
                  zgLog_.reset();
@@ -41,9 +45,14 @@ Registry::Impl::Impl()
                  if (_dbus)
                      g_dbus_connection_flush_sync(_dbus.get(), nullptr, nullptr);
                  _dbus.reset();
-             })
+             },
+             context)
     , jobs_{}
-    , _iconFinders{}
+    , memoryBudget_{std::make_shared<MemoryBudget>()}
+    , _iconFinders{std::make_shared<LruCache<std::string, std::shared_ptr<IconFinder>>>(
+          "icon-finders", memoryBudget_, [](const std::string& basePath, const std::shared_ptr<IconFinder>& finder) {
+              return basePath.size() + finder->footprint();
+          })}
     , _appStores{}
 {
     auto cancel = thread.getCancellable();
@@ -141,13 +150,20 @@ void Registry::Impl::zgSendEvent(AppID appid, const std::string& eventtype)
     });
 }
 
-std::shared_ptr<IconFinder>& Registry::Impl::getIconFinder(std::string basePath)
+/** Get the icon finder for a path, they take a while to build
+    so they're cached until the memory budget needs the space. */
+std::shared_ptr<IconFinder> Registry::Impl::getIconFinder(const std::string& basePath)
 {
-    if (_iconFinders.find(basePath) == _iconFinders.end())
-    {
-        _iconFinders[basePath] = std::make_shared<IconFinder>(basePath);
-    }
-    return _iconFinders[basePath];
+    return _iconFinders->get(basePath, [basePath]() { return std::make_shared<IconFinder>(basePath); });
+}
+
+/** Get the checkpointer for hibernated applications. Most users of
+    the registry never hibernate anything so we only set up CRIU the
+    first time it is asked for, unless one was set before that. */
+std::shared_ptr<checkpointer::Base> Registry::Impl::getCheckpointer()
+{
+    std::call_once(flag_checkpointer, [this]() { checkpointer_ = std::make_shared<checkpointer::Criu>(); });
+    return checkpointer_;
 }
 
 /** App start watching, if we're registered for the signal we
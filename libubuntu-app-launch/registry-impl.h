@@ -20,11 +20,15 @@
 #pragma once
 
 #include "app-store-base.h"
+#include "checkpointer-base.h"
 #include "glib-thread.h"
 #include "info-watcher-zg.h"
 #include "jobs-base.h"
+#include "lru-cache.h"
+#include "memory-budget.h"
 #include "registry.h"
 #include "snapd-info.h"
+#include "usage-ledger.h"
 #include <gio/gio.h>
 #include <json-glib/json-glib.h>
 #include <map>
@@ -49,7 +53,7 @@ class Base;
 class Registry::Impl
 {
 public:
-    Impl();
+    Impl(const std::shared_ptr<GMainContext>& context = {});
 
     virtual ~Impl()
     {
@@ -69,7 +73,7 @@ public:
     /** Snapd information object */
     snapd::Info snapdInfo;
 
-    std::shared_ptr<IconFinder>& getIconFinder(std::string basePath);
+    std::shared_ptr<IconFinder> getIconFinder(const std::string& basePath);
 
     virtual void zgSendEvent(AppID appid, const std::string& eventtype);
 
@@ -97,6 +101,30 @@ public:
         zgWatcher_ = watcher;
     }
 
+    const std::shared_ptr<MemoryBudget>& memoryBudget()
+    {
+        return memoryBudget_;
+    }
+
+    std::shared_ptr<checkpointer::Base> getCheckpointer();
+
+    void setCheckpointer(const std::shared_ptr<checkpointer::Base>& checkpointer)
+    {
+        /* Setting one means we don't want the default */
+        std::call_once(flag_checkpointer, []() {});
+        checkpointer_ = checkpointer;
+    }
+
+    std::shared_ptr<UsageLedger> getUsageLedger()
+    {
+        return usageLedger_;
+    }
+
+    void setUsageLedger(const std::shared_ptr<UsageLedger>& ledger)
+    {
+        usageLedger_ = ledger;
+    }
+
     core::Signal<const std::shared_ptr<Application>&>& appInfoUpdated();
     core::Signal<const std::shared_ptr<Application>&>& appAdded();
     core::Signal<const AppID&>& appRemoved();
@@ -146,9 +174,12 @@ private:
     /** Shared instance of the Zeitgeist Log */
     std::shared_ptr<ZeitgeistLog> zgLog_;
 
+    /** Budget shared by all of our caches */
+    std::shared_ptr<MemoryBudget> memoryBudget_;
+
     /** All of our icon finders based on the path that they're looking
         into */
-    std::unordered_map<std::string, std::shared_ptr<IconFinder>> _iconFinders;
+    std::shared_ptr<LruCache<std::string, std::shared_ptr<IconFinder>>> _iconFinders;
 
     /** Path to the OOM Helper */
     std::string oomHelper_;
@@ -178,6 +209,14 @@ private:
 
     /** ZG Info Watcher */
     std::shared_ptr<info_watcher::Zeitgeist> zgWatcher_;
+
+    /** Saves and restores hibernated applications, can be null */
+    std::shared_ptr<checkpointer::Base> checkpointer_;
+    /** Flag to see if we've chosen a checkpointer */
+    std::once_flag flag_checkpointer;
+
+    /** Running totals of application usage, can be null */
+    std::shared_ptr<UsageLedger> usageLedger_;
 };
 
 }  // namespace app_launch
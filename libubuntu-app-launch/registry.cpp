@@ -25,6 +25,10 @@
 #include "jobs-base.h"
 #include "registry-impl.h"
 #include "registry.h"
+#include "usage-ledger.h"
+#include <unity/util/GlibMemory.h>
+
+using namespace unity::util;
 
 namespace ubuntu
 {
@@ -32,11 +36,18 @@ namespace app_launch
 {
 
 Registry::Registry()
-    : impl{std::make_shared<Impl>()}
+    : Registry(nullptr)
+{
+}
+
+Registry::Registry(GMainContext* context)
+    : impl{std::make_shared<Impl>(context == nullptr ? std::shared_ptr<GMainContext>{}
+                                                     : share_glib(g_main_context_ref(context)))}
 {
     impl->setJobs(jobs::manager::Base::determineFactory(impl));
     impl->setAppStores(app_store::Base::allAppStores(impl));
     impl->setZgWatcher(std::make_shared<info_watcher::Zeitgeist>(impl));
+    impl->jobs()->trackInstances();
 }
 
 Registry::Registry(const std::shared_ptr<Impl>& inimpl)
@@ -81,6 +92,62 @@ void Registry::clearManager()
     impl->jobs()->clearManager();
 }
 
+void Registry::setRestartPolicy(const RestartPolicy& policy, const std::shared_ptr<Registry>& registry)
+{
+    registry->impl->jobs()->setRestartPolicy(policy);
+}
+
+void Registry::setInstanceCaps(const InstanceCaps& caps, const std::shared_ptr<Registry>& registry)
+{
+    registry->impl->jobs()->setInstanceCaps(caps);
+}
+
+void Registry::trackUsage(const std::shared_ptr<Registry>& registry)
+{
+    registry->impl->jobs()->trackUsage();
+}
+
+Registry::Usage Registry::appUsage(const AppID& appid, const std::shared_ptr<Registry>& registry)
+{
+    auto ledger = registry->impl->getUsageLedger();
+    if (ledger)
+    {
+        return ledger->usage(appid);
+    }
+
+    auto saved = UsageLedger::savedUsage();
+    auto usage = saved.find(appid);
+    if (usage == saved.end())
+    {
+        return {std::chrono::milliseconds{0}, 0, std::chrono::system_clock::time_point{}};
+    }
+
+    return usage->second;
+}
+
+std::map<AppID, Registry::Usage> Registry::allAppUsage(const std::shared_ptr<Registry>& registry)
+{
+    std::map<AppID, Usage> retval;
+    auto ledger = registry->impl->getUsageLedger();
+
+    for (const auto& usage : ledger ? ledger->allUsage() : UsageLedger::savedUsage())
+    {
+        retval.emplace(AppID::parse(usage.first), usage.second);
+    }
+
+    return retval;
+}
+
+void Registry::setMemoryBudget(std::size_t bytes, const std::shared_ptr<Registry>& registry)
+{
+    registry->impl->memoryBudget()->setCap(bytes);
+}
+
+std::list<Registry::CacheStats> Registry::cacheStats(const std::shared_ptr<Registry>& registry)
+{
+    return registry->impl->memoryBudget()->stats();
+}
+
 std::shared_ptr<Registry> defaultRegistry;
 std::shared_ptr<Registry> Registry::getDefault()
 {
@@ -164,5 +231,13 @@ core::Signal<const AppID&>& Registry::appRemoved(const std::shared_ptr<Registry>
     return reg->impl->appRemoved();
 }
 
+std::shared_ptr<Registry::LifecycleSubscription> Registry::subscribeLifecycle(
+    const LifecycleFilter& filter,
+    std::function<void(const LifecycleChange&)> callback,
+    const std::shared_ptr<Registry>& reg)
+{
+    return reg->impl->jobs()->subscribeLifecycle(filter, callback);
+}
+
 }  // namespace app_launch
 }  // namespace ubuntu
@@ -17,10 +17,15 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
+#include <chrono>
+#include <cstdint>
 #include <core/signal.h>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "application.h"
 #include "helper.h"
@@ -28,6 +33,8 @@
 #pragma once
 #pragma GCC visibility push(default)
 
+typedef struct _GMainContext GMainContext;
+
 namespace ubuntu
 {
 namespace app_launch
@@ -49,12 +56,32 @@ public:
         failed. */
     enum class FailureType
     {
-        CRASH,        /**< The application was running, but failed while running. */
-        START_FAILURE /**< Something in the configuration of the application made it impossible to start the
-                         application */
+        CRASH,         /**< The application was running, but failed while running. */
+        START_FAILURE, /**< Something in the configuration of the application made it impossible to start the
+                          application */
+        NONE           /**< Not a failure, for lifecycle events that aren't failures */
+    };
+
+    /** Why a job stopped */
+    enum class StopReason
+    {
+        STOPPED, /**< The job exited or was asked to stop */
+        RETIRED  /**< UAL stopped a paused instance to stay under the instance cap */
     };
 
     Registry();
+    /** Create a registry that uses the caller's main context instead
+        of creating its own thread. All of the D-Bus subscriptions,
+        timers and asynchronous calls are attached to @context and
+        the caller is responsible for iterating it from the thread
+        creating the registry. Calls made from that thread are done
+        inline, calls from other threads wait for it to dispatch them,
+        and signals are emitted while dispatching it.
+
+        \param context Main context to use, nullptr creates a thread
+                        just like the default constructor
+    */
+    explicit Registry(GMainContext* context);
     virtual ~Registry();
 
     /* Lots of application lists */
@@ -156,6 +183,63 @@ public:
     */
     static core::Signal<const AppID&>& appRemoved(const std::shared_ptr<Registry>& reg = getDefault());
 
+    /** Lifecycle events, combined into a mask for a LifecycleFilter */
+    enum LifecycleEvent : unsigned int
+    {
+        LIFECYCLE_STARTED = 1 << 0, /**< A job was started */
+        LIFECYCLE_STOPPED = 1 << 1, /**< A job was stopped */
+        LIFECYCLE_FAILED = 1 << 2,  /**< A job failed */
+        LIFECYCLE_PAUSED = 1 << 3,  /**< An application was paused */
+        LIFECYCLE_RESUMED = 1 << 4, /**< An application was resumed */
+        LIFECYCLE_ALL = 0x1f        /**< All of the events */
+    };
+
+    /** Which lifecycle events a subscriber wants */
+    struct LifecycleFilter
+    {
+        std::string appid;   /**< AppID, or a pattern using '*' and '?' like 'com.example.app_*', empty for all */
+        std::string job;     /**< Job type, like 'application-snap' or a helper type, empty for all */
+        unsigned int events; /**< Mask of LifecycleEvent values */
+    };
+
+    /** A lifecycle event delivered to a filtered subscription. Only the IDs
+        are included so that nothing has to be looked up to deliver it. */
+    struct LifecycleChange
+    {
+        LifecycleEvent event;    /**< What happened */
+        std::string job;         /**< Job type, empty for a pause or resume of an instance we don't know about */
+        std::string appid;       /**< Application or helper that it happened to */
+        std::string instance;    /**< Instance ID */
+        FailureType reason;      /**< Why it failed, NONE for everything but failures */
+        StopReason stopReason;   /**< Why it stopped, only set for stops */
+        std::vector<pid_t> pids; /**< Processes that were paused or resumed */
+    };
+
+    /** A filtered subscription, events are delivered until it is destroyed */
+    class LifecycleSubscription
+    {
+    public:
+        virtual ~LifecycleSubscription() = default;
+
+    protected:
+        LifecycleSubscription() = default;
+    };
+
+    /** Subscribe to the lifecycle events that match a filter. Unlike the
+        signals above, events that don't match any subscription are dropped
+        before the application or helper objects are built.
+
+        \note The callback is activated on the UAL thread
+
+        \param filter Events that the subscriber wants
+        \param callback Function called for each matching event
+        \param reg Registry to subscribe on
+    */
+    static std::shared_ptr<LifecycleSubscription> subscribeLifecycle(
+        const LifecycleFilter& filter,
+        std::function<void(const LifecycleChange&)> callback,
+        const std::shared_ptr<Registry>& reg = getDefault());
+
     /** The Application Manager, almost always if you're not Unity8, don't
         use this API. Testing is a special case. Subclass this interface and
         implement these functions.
@@ -233,6 +317,108 @@ public:
     /** Remove the current manager on the registry */
     void clearManager();
 
+    /** Policy for restarting applications that crash. Each crash of an
+        application waits twice as long as the previous one before restarting
+        it, up to the maximum delay. An application that stays up for the
+        stable time gets its count reset. */
+    struct RestartPolicy
+    {
+        bool enabled;                           /**< Restart crashed applications, off by default */
+        unsigned int maxRestarts;               /**< Restarts allowed before we give up on an application */
+        std::chrono::milliseconds initialDelay; /**< Delay before the first restart */
+        std::chrono::milliseconds maxDelay;     /**< Largest delay between restarts */
+        std::chrono::seconds stableTime;        /**< Time running after which a crash starts over */
+    };
+
+    /** Set the policy for automatically restarting applications that
+        crash. Only crashes cause restarts, applications that fail to start
+        or are stopped are left alone.
+
+        \param policy Restart policy to use
+        \param registry Registry to set the policy on
+    */
+    static void setRestartPolicy(const RestartPolicy& policy, const std::shared_ptr<Registry>& registry = getDefault());
+
+    /** Limits on the number of instances of an application that are kept
+        around. When a new instance would go over the limit the paused
+        instance that was resumed the longest time ago is stopped. Helpers
+        aren't capped as they don't get paused. */
+    struct InstanceCaps
+    {
+        unsigned int applications;                  /**< Instances of each application, zero for no limit */
+        std::map<std::string, unsigned int> appids; /**< Overrides for specific AppIDs, zero for no limit */
+    };
+
+    /** Set the caps on the number of instances. Instances that are stopped
+        to stay under a cap are reported as stopped with the RETIRED reason
+        to lifecycle subscriptions, in this process and any other using UAL
+        on the session bus.
+
+        \param caps Instance caps to use
+        \param registry Registry to set the caps on
+    */
+    static void setInstanceCaps(const InstanceCaps& caps, const std::shared_ptr<Registry>& registry = getDefault());
+
+    /** Usage of an application tracked by UAL. This is kept as the
+        application is started, paused and resumed so it is cheap to get. */
+    struct Usage
+    {
+        std::chrono::milliseconds foregroundTime;       /**< Total time spent in the foreground */
+        unsigned int launches;                          /**< Number of times the application was started */
+        std::chrono::system_clock::time_point lastUsed; /**< Last time it was started, paused or resumed */
+    };
+
+    /** Keep the usage ledger in this process. It follows applications
+        starting, stopping, pausing and resuming across the session and
+        saves the totals for everyone else to read. Only one process,
+        normally the shell, should do this.
+
+        \param registry Registry to track the usage on
+    */
+    static void trackUsage(const std::shared_ptr<Registry>& registry = getDefault());
+
+    /** Get the usage of an application. Applications that have never been
+        used return all zeros. Processes that aren't tracking the usage get
+        what was last saved by the one that is.
+
+        \param appid Application to look up
+        \param registry Registry tracking the usage
+    */
+    static Usage appUsage(const AppID& appid, const std::shared_ptr<Registry>& registry = getDefault());
+
+    /** Get the usage of all the applications that have been used
+
+        \param registry Registry tracking the usage
+    */
+    static std::map<AppID, Usage> allAppUsage(const std::shared_ptr<Registry>& registry = getDefault());
+
+    /** Statistics for one of the caches kept by the registry */
+    struct CacheStats
+    {
+        std::string name;        /**< Name of the cache */
+        std::size_t entries;     /**< Number of entries in the cache */
+        std::size_t bytes;       /**< Approximate memory used by the cache */
+        std::uint64_t hits;      /**< Lookups that were in the cache */
+        std::uint64_t misses;    /**< Lookups that weren't in the cache */
+        std::uint64_t evictions; /**< Entries dropped to stay under the memory budget */
+    };
+
+    /** Set the memory budget for the caches kept by the registry. When
+        the caches go over it the least recently used entries are dropped.
+        Some state, like the list of running units, can't be dropped and
+        only counts against the budget.
+
+        \param bytes Approximate bytes allowed, zero for no limit
+        \param registry Registry to set the budget on
+    */
+    static void setMemoryBudget(std::size_t bytes, const std::shared_ptr<Registry>& registry = getDefault());
+
+    /** Get the size and hit rate of each of the caches kept by the registry
+
+        \param registry Registry to get the statistics for
+    */
+    static std::list<CacheStats> cacheStats(const std::shared_ptr<Registry>& registry = getDefault());
+
     /* Helper Lists */
     /** Get a list of all the helpers for a given helper type
 
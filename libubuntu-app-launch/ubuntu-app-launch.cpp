@@ -443,6 +443,8 @@ ubuntu_app_launch_observer_add_app_failed (UbuntuAppLaunchAppFailedObserver obse
 						case ubuntu::app_launch::Registry::FailureType::START_FAILURE:
 							ctype = UBUNTU_APP_LAUNCH_APP_FAILED_START_FAILURE;
 							break;
+						case ubuntu::app_launch::Registry::FailureType::NONE:
+							break;
 						}
 
 						observer(appid.c_str(), ctype, user_data);
@@ -0,0 +1,305 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "usage-ledger.h"
+#include "registry-impl.h"
+#include "string-util.h"
+
+#include <glib/gstdio.h>
+#include <unity/util/GlibMemory.h>
+
+using namespace unity::util;
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** How long to wait after a change before writing the ledger, so that
+    a burst of pauses and resumes only causes one write */
+static const std::chrono::seconds SAVE_DELAY{2};
+
+UsageLedger::UsageLedger(const std::shared_ptr<Registry::Impl>& registry)
+    : registry_(registry)
+    , path_(ledgerPath())
+{
+    entries_ = loadEntries(path_);
+}
+
+UsageLedger::~UsageLedger()
+{
+    /* The registry thread is gone by now, so anything
+       that is pending gets written here */
+    if (dirty_)
+    {
+        save();
+    }
+}
+
+/** An instance of the application started, it counts as a launch and
+    we expect it to be in the foreground. */
+void UsageLedger::started(const std::string& appid, const std::string& instanceid)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    auto& ent = entry(appid);
+
+    ent.launches++;
+    ent.lastUsed = std::chrono::system_clock::now();
+    enterForeground(ent, instanceid);
+
+    queueSave();
+}
+
+/** An instance of the application is gone */
+void UsageLedger::stopped(const std::string& appid, const std::string& instanceid)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    auto& ent = entry(appid);
+
+    leaveForeground(ent, instanceid);
+
+    queueSave();
+}
+
+/** An instance of the application was brought to the foreground */
+void UsageLedger::resumed(const std::string& appid, const std::string& instanceid)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    auto& ent = entry(appid);
+
+    ent.lastUsed = std::chrono::system_clock::now();
+    enterForeground(ent, instanceid);
+
+    queueSave();
+}
+
+/** An instance of the application left the foreground */
+void UsageLedger::paused(const std::string& appid, const std::string& instanceid)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    auto& ent = entry(appid);
+
+    ent.lastUsed = std::chrono::system_clock::now();
+    leaveForeground(ent, instanceid);
+
+    queueSave();
+}
+
+/** Get the usage of a single application, all zeros if we
+    haven't seen it. Time that it is currently spending in the
+    foreground is included. */
+Registry::Usage UsageLedger::usage(const std::string& appid)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    auto it = entries_.find(appid);
+    if (it == entries_.end())
+    {
+        return {std::chrono::milliseconds{0}, 0, std::chrono::system_clock::time_point{}};
+    }
+
+    return entryToUsage(it->second);
+}
+
+/** Get the usage of every application in the ledger */
+std::map<std::string, Registry::Usage> UsageLedger::allUsage()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    std::map<std::string, Registry::Usage> retval;
+
+    for (const auto& ent : entries_)
+    {
+        retval.emplace(ent.first, entryToUsage(ent.second));
+    }
+
+    return retval;
+}
+
+/** Find the entry for an application, creating it if needed */
+UsageLedger::Entry& UsageLedger::entry(const std::string& appid)
+{
+    auto it = entries_.find(appid);
+    if (it == entries_.end())
+    {
+        it = entries_
+                 .emplace(appid, Entry{std::chrono::milliseconds{0}, 0, std::chrono::system_clock::time_point{}, {},
+                                       std::chrono::steady_clock::time_point{}})
+                 .first;
+    }
+
+    return it->second;
+}
+
+void UsageLedger::enterForeground(Entry& entry, const std::string& instanceid)
+{
+    if (entry.foreground.empty())
+    {
+        entry.foregroundSince = std::chrono::steady_clock::now();
+    }
+
+    entry.foreground.insert(instanceid);
+}
+
+/** Removes the instance from the foreground, and if it was the last
+    one there adds the time to the total */
+void UsageLedger::leaveForeground(Entry& entry, const std::string& instanceid)
+{
+    if (entry.foreground.erase(instanceid) == 0 || !entry.foreground.empty())
+    {
+        return;
+    }
+
+    entry.foregroundTime += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                                  entry.foregroundSince);
+}
+
+Registry::Usage UsageLedger::entryToUsage(const Entry& entry)
+{
+    auto foregroundTime = entry.foregroundTime;
+    if (!entry.foreground.empty())
+    {
+        foregroundTime += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                                entry.foregroundSince);
+    }
+
+    return {foregroundTime, entry.launches, entry.lastUsed};
+}
+
+/** Where the ledger is kept */
+std::string UsageLedger::ledgerPath()
+{
+    auto envpath = getenv("UBUNTU_APP_LAUNCH_USAGE_LEDGER");
+    if (envpath != nullptr)
+    {
+        return envpath;
+    }
+
+    auto cpath = unique_gchar(g_build_filename(g_get_user_data_dir(), "ubuntu-app-launch", "usage-ledger", nullptr));
+    return cpath.get();
+}
+
+/** Read the ledger from disk. There is a group for each AppID, instances
+    aren't saved as nothing is in the foreground when we start. */
+std::map<std::string, UsageLedger::Entry> UsageLedger::loadEntries(const std::string& path)
+{
+    std::map<std::string, Entry> entries;
+
+    auto keyfile = share_glib(g_key_file_new());
+    if (!g_key_file_load_from_file(keyfile.get(), path.c_str(), G_KEY_FILE_NONE, nullptr))
+    {
+        g_debug("No usage ledger at: %s", path.c_str());
+        return entries;
+    }
+
+    auto groups = unique_gcharv(g_key_file_get_groups(keyfile.get(), nullptr));
+    for (int i = 0; groups.get()[i] != nullptr; i++)
+    {
+        const gchar* group = groups.get()[i];
+
+        auto foregroundTime = g_key_file_get_int64(keyfile.get(), group, "ForegroundTime", nullptr);
+        auto launches = g_key_file_get_uint64(keyfile.get(), group, "Launches", nullptr);
+        auto lastUsed = g_key_file_get_int64(keyfile.get(), group, "LastUsed", nullptr);
+
+        entries.emplace(group, Entry{std::chrono::milliseconds{foregroundTime}, static_cast<unsigned int>(launches),
+                                     std::chrono::system_clock::time_point{std::chrono::milliseconds{lastUsed}},
+                                     {},
+                                     std::chrono::steady_clock::time_point{}});
+    }
+
+    return entries;
+}
+
+/** Get the usage as last saved by the process keeping the ledger, for
+    processes that don't keep it themselves */
+std::map<std::string, Registry::Usage> UsageLedger::savedUsage()
+{
+    std::map<std::string, Registry::Usage> retval;
+
+    for (const auto& ent : loadEntries(ledgerPath()))
+    {
+        retval.emplace(ent.first, entryToUsage(ent.second));
+    }
+
+    return retval;
+}
+
+/** Write the ledger to disk. Time currently in the foreground isn't
+    included as we don't know whether that instance will survive us. */
+void UsageLedger::save()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    saveTimeout_ = 0;
+
+    auto keyfile = share_glib(g_key_file_new());
+    for (const auto& ent : entries_)
+    {
+        auto group = ent.first.c_str();
+        g_key_file_set_int64(keyfile.get(), group, "ForegroundTime", ent.second.foregroundTime.count());
+        g_key_file_set_uint64(keyfile.get(), group, "Launches", ent.second.launches);
+        g_key_file_set_int64(
+            keyfile.get(), group, "LastUsed",
+            std::chrono::duration_cast<std::chrono::milliseconds>(ent.second.lastUsed.time_since_epoch()).count());
+    }
+
+    gsize length = 0;
+    auto data = unique_gchar(g_key_file_to_data(keyfile.get(), &length, nullptr));
+
+    auto dir = unique_gchar(g_path_get_dirname(path_.c_str()));
+    g_mkdir_with_parents(dir.get(), 0700);
+
+    GError* error = nullptr;
+    g_file_set_contents(path_.c_str(), data.get(), length, &error);
+    if (error != nullptr)
+    {
+        g_warning("Unable to write usage ledger '%s': %s", path_.c_str(), error->message);
+        g_error_free(error);
+        return;
+    }
+
+    dirty_ = false;
+}
+
+/** Schedule a save on the registry thread, called with the lock held */
+void UsageLedger::queueSave()
+{
+    dirty_ = true;
+
+    if (saveTimeout_ != 0)
+    {
+        return;
+    }
+
+    auto reg = registry_.lock();
+    if (!reg)
+    {
+        return;
+    }
+
+    std::weak_ptr<UsageLedger> weakThis = shared_from_this();
+    saveTimeout_ = reg->thread.timeout(SAVE_DELAY, [weakThis]() {
+        auto pthis = weakThis.lock();
+        if (pthis)
+        {
+            pthis->save();
+        }
+    });
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,99 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "registry.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include <glib.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** Keeps a running total of how each application is used so that nobody
+    needs to rebuild it from the Zeitgeist history. It is updated as
+    instances are started, stopped, paused and resumed, and saved to a
+    key file in the user's data directory a little while after each change.
+    Any instance of an application being resumed counts as the application
+    being in the foreground.
+
+    Only one process keeps the ledger, everyone else reads what it saved
+    with savedUsage(). */
+class UsageLedger : public std::enable_shared_from_this<UsageLedger>
+{
+public:
+    UsageLedger(const std::shared_ptr<Registry::Impl>& registry);
+    virtual ~UsageLedger();
+
+    void started(const std::string& appid, const std::string& instanceid);
+    void stopped(const std::string& appid, const std::string& instanceid);
+    void resumed(const std::string& appid, const std::string& instanceid);
+    void paused(const std::string& appid, const std::string& instanceid);
+
+    Registry::Usage usage(const std::string& appid);
+    std::map<std::string, Registry::Usage> allUsage();
+
+    void save();
+
+    static std::map<std::string, Registry::Usage> savedUsage();
+
+private:
+    /** Ledger entry for a single application */
+    struct Entry
+    {
+        std::chrono::milliseconds foregroundTime;              /**< Saved time in the foreground */
+        unsigned int launches;                                 /**< Number of times started */
+        std::chrono::system_clock::time_point lastUsed;        /**< Last time it was started, resumed or paused */
+        std::set<std::string> foreground;                      /**< Instances in the foreground right now */
+        std::chrono::steady_clock::time_point foregroundSince; /**< When the first of those got there */
+    };
+
+    /** Pointer to our implementing registry */
+    std::weak_ptr<Registry::Impl> registry_;
+    /** Key file the ledger is stored in */
+    std::string path_;
+    /** Protects everything below, pause and resume come from any thread */
+    std::mutex lock_;
+    /** All the applications we've seen */
+    std::map<std::string, Entry> entries_;
+    /** Source ID for the pending save, zero if none */
+    guint saveTimeout_{0};
+    /** Entries have changed since the last save */
+    bool dirty_{false};
+
+    Entry& entry(const std::string& appid);
+    void enterForeground(Entry& entry, const std::string& instanceid);
+    void leaveForeground(Entry& entry, const std::string& instanceid);
+    static Registry::Usage entryToUsage(const Entry& entry);
+    static std::string ledgerPath();
+    static std::map<std::string, Entry> loadEntries(const std::string& path);
+    void queueSave();
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
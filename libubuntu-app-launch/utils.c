@@ -137,7 +137,7 @@ uri2file (const gchar * uri)
 
 /* Put the list of files into the argument array */
 static inline void
-file_list_handling (GArray * outarray, gchar ** list, gchar * (*dup_func) (const gchar * in))
+file_list_handling (GArray * outarray, const gchar * const * list, gchar * (*dup_func) (const gchar * in))
 {
 	/* No URLs, cool, this is a noop */
 	if (list == NULL || list[0] == NULL) {
@@ -159,7 +159,7 @@ file_list_handling (GArray * outarray, gchar ** list, gchar * (*dup_func) (const
 
 /* Parse a desktop exec line and return the next string */
 static void
-desktop_exec_segment_parse (GArray * finalarray, const gchar * execsegment, gchar ** uri_list)
+desktop_exec_segment_parse (GArray * finalarray, const gchar * execsegment, const gchar * const * uri_list)
 {
 	/* No NULL strings */
 	if (execsegment == NULL || execsegment[0] == '\0')
@@ -277,8 +277,36 @@ GArray *
 desktop_exec_parse (const gchar * execline, const gchar * urilist)
 {
 	GError * error = NULL;
-	gchar ** splitexec = NULL;
 	gchar ** splituris = NULL;
+
+	if (urilist != NULL && urilist[0] != '\0') {
+		g_shell_parse_argv(urilist, NULL, &splituris, &error);
+
+		if (error != NULL) {
+			g_warning("Unable to parse URIs '%s': %s", urilist, error->message);
+			g_error_free(error);
+			/* Continuing without URIs */
+			splituris = NULL;
+		}
+	}
+
+	GArray * newargv = desktop_exec_parse_uris(execline, (const gchar * const *)splituris);
+
+	if (splituris != NULL) {
+		g_strfreev(splituris);
+	}
+
+	return newargv;
+}
+
+/* Same as desktop_exec_parse() but takes the URIs as an already split
+   NULL terminated array so that they never need to be quoted and then
+   parsed again. */
+GArray *
+desktop_exec_parse_uris (const gchar * execline, const gchar * const * urilist)
+{
+	GError * error = NULL;
+	gchar ** splitexec = NULL;
 	gint execitems = 0;
 
 	/* This returns from desktop file style quoting to straight strings with
@@ -293,29 +321,13 @@ desktop_exec_parse (const gchar * execline, const gchar * urilist)
 		return NULL;
 	}
 
-	if (urilist != NULL && urilist[0] != '\0') {
-		g_shell_parse_argv(urilist, NULL, &splituris, &error);
-
-		if (error != NULL) {
-			g_warning("Unable to parse URIs '%s': %s", urilist, error->message);
-			g_error_free(error);
-			/* Continuing without URIs */
-			splituris = NULL;
-		}
-	}
-
-
 	GArray * newargv = g_array_new(TRUE, FALSE, sizeof(gchar *));
 	int i;
 	for (i = 0; i < execitems; i++) {
-		desktop_exec_segment_parse(newargv, splitexec[i], splituris);
+		desktop_exec_segment_parse(newargv, splitexec[i], urilist);
 	}
 	g_strfreev(splitexec);
 
-	if (splituris != NULL) {
-		g_strfreev(splituris);
-	}
-
 	/* Each string here should be its own param */
 
 	return newargv;
@@ -29,6 +29,8 @@ gchar *   desktop_to_exec        (GKeyFile *      desktop_file,
                                   const gchar *   from);
 GArray *  desktop_exec_parse     (const gchar *   execline,
                                   const gchar *   uri_list);
+GArray *  desktop_exec_parse_uris (const gchar *   execline,
+                                  const gchar * const * uri_list);
 GKeyFile * keyfile_for_appid     (const gchar *   appid,
                                   gchar * *       desktopfile);
 
@@ -402,6 +402,38 @@ TEST_F(ApplicationInfoDesktop, XMirCases)
                      .value());
 }
 
+TEST_F(ApplicationInfoDesktop, Hibernate)
+{
+    auto unset = defaultKeyfile();
+    EXPECT_FALSE(ubuntu::app_launch::app_info::Desktop(simpleAppID(), unset, "/", {},
+                                                       ubuntu::app_launch::app_info::DesktopFlags::NONE, nullptr)
+                     .hibernate()
+                     .value());
+
+    auto hibernate = defaultKeyfile();
+    g_key_file_set_boolean(hibernate.get(), DESKTOP, "X-Ubuntu-Hibernate", TRUE);
+    EXPECT_TRUE(ubuntu::app_launch::app_info::Desktop(simpleAppID(), hibernate, "/", {},
+                                                      ubuntu::app_launch::app_info::DesktopFlags::NONE, nullptr)
+                    .hibernate()
+                    .value());
+}
+
+TEST_F(ApplicationInfoDesktop, UrisFile)
+{
+    auto unset = defaultKeyfile();
+    EXPECT_FALSE(ubuntu::app_launch::app_info::Desktop(simpleAppID(), unset, "/", {},
+                                                       ubuntu::app_launch::app_info::DesktopFlags::NONE, nullptr)
+                     .urisFile()
+                     .value());
+
+    auto urisfile = defaultKeyfile();
+    g_key_file_set_boolean(urisfile.get(), DESKTOP, "X-Ubuntu-URIs-File", TRUE);
+    EXPECT_TRUE(ubuntu::app_launch::app_info::Desktop(simpleAppID(), urisfile, "/", {},
+                                                      ubuntu::app_launch::app_info::DesktopFlags::NONE, nullptr)
+                    .urisFile()
+                    .value());
+}
+
 TEST_F(ApplicationInfoDesktop, Popularity)
 {
     EXPECT_CALL(*zgWatcher(), lookupAppPopularity(simpleAppID()))
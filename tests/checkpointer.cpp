@@ -0,0 +1,162 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "checkpointer-base.h"
+
+#include "registry-mock.h"
+
+#include <gio/gio.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#define CHECKPOINT_DIR (CMAKE_BINARY_DIR "/checkpointer-test")
+
+class Checkpointer : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        g_setenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR", CHECKPOINT_DIR, TRUE);
+    }
+
+    virtual void TearDown()
+    {
+        g_spawn_command_line_sync("rm -rf " CHECKPOINT_DIR, nullptr, nullptr, nullptr, nullptr);
+        g_unsetenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR");
+    }
+
+    static ubuntu::app_launch::AppID simpleAppID()
+    {
+        return {ubuntu::app_launch::AppID::Package::from_raw("package"),
+                ubuntu::app_launch::AppID::AppName::from_raw("appname"),
+                ubuntu::app_launch::AppID::Version::from_raw("version")};
+    }
+
+    static bool writeImage(const std::string& imagedir)
+    {
+        auto file = imagedir + "/core.img";
+        return g_file_set_contents(file.c_str(), "image", -1, nullptr) == TRUE;
+    }
+
+    /* Our mock dumps finish right away so we can check the result inline */
+    static bool checkpoint(MockCheckpointer& checkpointer, pid_t pid)
+    {
+        bool saved{false};
+        checkpointer.checkpoint(simpleAppID(), pid, nullptr, [&saved](bool result) { saved = result; });
+        return saved;
+    }
+
+    static void dumpImage(pid_t, const std::string& dir, GCancellable*, const std::function<void(bool)>& finished)
+    {
+        finished(writeImage(dir));
+    }
+};
+
+TEST_F(Checkpointer, Checkpoint)
+{
+    MockCheckpointer checkpointer;
+
+    EXPECT_FALSE(checkpointer.hasImage(simpleAppID()));
+
+    EXPECT_CALL(checkpointer, dump(1234, checkpointer.imageDir(simpleAppID()) + ".tmp", testing::_, testing::_))
+        .WillOnce(testing::Invoke(dumpImage));
+
+    EXPECT_TRUE(checkpoint(checkpointer, 1234));
+    EXPECT_TRUE(checkpointer.hasImage(simpleAppID()));
+
+    /* A second checkpoint replaces the first */
+    EXPECT_CALL(checkpointer, dump(4321, testing::_, testing::_, testing::_)).WillOnce(testing::Invoke(dumpImage));
+
+    EXPECT_TRUE(checkpoint(checkpointer, 4321));
+    EXPECT_TRUE(checkpointer.hasImage(simpleAppID()));
+
+    checkpointer.discard(simpleAppID());
+    EXPECT_FALSE(checkpointer.hasImage(simpleAppID()));
+}
+
+TEST_F(Checkpointer, CheckpointFailed)
+{
+    MockCheckpointer checkpointer;
+
+    EXPECT_CALL(checkpointer, dump(1234, testing::_, testing::_, testing::_))
+        .WillOnce(testing::Invoke(
+            [](pid_t, const std::string& dir, GCancellable*, const std::function<void(bool)>& finished) {
+                writeImage(dir);
+                finished(false);
+            }));
+
+    EXPECT_FALSE(checkpoint(checkpointer, 1234));
+    EXPECT_FALSE(checkpointer.hasImage(simpleAppID()));
+    EXPECT_FALSE(g_file_test((checkpointer.imageDir(simpleAppID()) + ".tmp").c_str(), G_FILE_TEST_EXISTS));
+}
+
+TEST_F(Checkpointer, Restore)
+{
+    MockCheckpointer checkpointer;
+    std::string unitname{"ubuntu-app-launch--application-legacy--appname--.service"};
+
+    /* Nothing to restore */
+    EXPECT_CALL(checkpointer, restoreCommand(testing::_)).Times(0);
+    EXPECT_TRUE(checkpointer.restore(simpleAppID(), unitname).empty());
+
+    EXPECT_CALL(checkpointer, dump(1234, testing::_, testing::_, testing::_)).WillOnce(testing::Invoke(dumpImage));
+    ASSERT_TRUE(checkpoint(checkpointer, 1234));
+
+    /* The image moves to the unit */
+    auto restoredir = checkpointer.restoreDir(unitname);
+    std::vector<std::string> command{"restore", restoredir};
+    EXPECT_CALL(checkpointer, restoreCommand(restoredir)).WillOnce(testing::Return(command));
+
+    EXPECT_EQ(command, checkpointer.restore(simpleAppID(), unitname));
+    EXPECT_FALSE(checkpointer.hasImage(simpleAppID()));
+    EXPECT_TRUE(g_file_test((restoredir + "/core.img").c_str(), G_FILE_TEST_EXISTS));
+
+    /* Only restored once */
+    EXPECT_TRUE(checkpointer.restore(simpleAppID(), unitname).empty());
+
+    checkpointer.restoreFinished(unitname);
+    EXPECT_FALSE(g_file_test(restoredir.c_str(), G_FILE_TEST_EXISTS));
+}
+
+TEST_F(Checkpointer, Unclaim)
+{
+    MockCheckpointer checkpointer;
+    std::string unitname{"ubuntu-app-launch--application-legacy--appname--.service"};
+
+    EXPECT_CALL(checkpointer, dump(1234, testing::_, testing::_, testing::_)).WillOnce(testing::Invoke(dumpImage));
+    ASSERT_TRUE(checkpoint(checkpointer, 1234));
+
+    EXPECT_CALL(checkpointer, restoreCommand(testing::_))
+        .WillRepeatedly(testing::Return(std::vector<std::string>{"restore"}));
+    ASSERT_FALSE(checkpointer.restore(simpleAppID(), unitname).empty());
+
+    /* The unit didn't start, the image goes back */
+    checkpointer.unclaim(simpleAppID(), unitname);
+    EXPECT_TRUE(checkpointer.hasImage(simpleAppID()));
+    EXPECT_FALSE(g_file_test(checkpointer.restoreDir(unitname).c_str(), G_FILE_TEST_EXISTS));
+
+    /* A newer image wins */
+    ASSERT_FALSE(checkpointer.restore(simpleAppID(), unitname).empty());
+    EXPECT_CALL(checkpointer, dump(4321, testing::_, testing::_, testing::_)).WillOnce(testing::Invoke(dumpImage));
+    ASSERT_TRUE(checkpoint(checkpointer, 4321));
+
+    checkpointer.unclaim(simpleAppID(), unitname);
+    EXPECT_TRUE(checkpointer.hasImage(simpleAppID()));
+    EXPECT_FALSE(g_file_test(checkpointer.restoreDir(unitname).c_str(), G_FILE_TEST_EXISTS));
+}
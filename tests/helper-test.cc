@@ -235,6 +235,36 @@ TEST_F(HelperTest, DesktopExecParse)
 	return;
 }
 
+TEST_F(HelperTest, DesktopExecParseUris)
+{
+	GArray * output;
+
+	/* No URLs */
+	output = desktop_exec_parse_uris("foo %U", NULL);
+	ASSERT_EQ(1u, output->len);
+	ASSERT_STREQ(g_array_index(output, gchar *, 0), "foo");
+	g_array_free(output, TRUE);
+
+	/* URLs that would need quoting are passed as they are */
+	const gchar * uris[] = {"http://ubuntu.com", "file:///foo bar/it's", "\"", NULL};
+	output = desktop_exec_parse_uris("foo %U", uris);
+	ASSERT_EQ(4u, output->len);
+	ASSERT_STREQ(g_array_index(output, gchar *, 0), "foo");
+	ASSERT_STREQ(g_array_index(output, gchar *, 1), "http://ubuntu.com");
+	ASSERT_STREQ(g_array_index(output, gchar *, 2), "file:///foo bar/it's");
+	ASSERT_STREQ(g_array_index(output, gchar *, 3), "\"");
+	g_array_free(output, TRUE);
+
+	/* Little %u only takes the first */
+	output = desktop_exec_parse_uris("foo %u", uris);
+	ASSERT_EQ(2u, output->len);
+	ASSERT_STREQ(g_array_index(output, gchar *, 0), "foo");
+	ASSERT_STREQ(g_array_index(output, gchar *, 1), "http://ubuntu.com");
+	g_array_free(output, TRUE);
+
+	return;
+}
+
 TEST_F(HelperTest, KeyfileForAppid)
 {
 	GKeyFile * keyfile = NULL;
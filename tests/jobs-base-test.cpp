@@ -17,12 +17,14 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
+#include "app-store-legacy.h"
 #include "appid.h"
 #include "jobs-base.h"
 
 #include "eventually-fixture.h"
 #include "registry-mock.h"
 #include "spew-master.h"
+#include <future>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <libdbustest/dbus-test.h>
@@ -226,3 +228,335 @@ TEST_F(JobBaseTest, pauseResumeMany)
         EXPECT_EQ(std::to_string(int(ubuntu::app_launch::oom::focused())), spew.oomScore());
     }
 }
+
+TEST_F(JobBaseTest, hibernateNoCheckpointer)
+{
+    registry->impl->setCheckpointer(nullptr);
+
+    auto instance = simpleInstance();
+    EXPECT_CALL(*instance, stop()).Times(0);
+
+    EXPECT_FALSE(instance->hibernate());
+}
+
+TEST_F(JobBaseTest, hibernate)
+{
+    g_setenv("XDG_DATA_DIRS", CMAKE_SOURCE_DIR, TRUE);
+    g_setenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR", CMAKE_BINARY_DIR "/jobs-base-checkpoints", TRUE);
+
+    core::Signal<const std::string&, const std::string&, const std::string&> started;
+    core::Signal<const std::string&, const std::string&, const std::string&> stopped;
+    core::Signal<const std::string&, const std::string&, const std::string&, ubuntu::app_launch::Registry::FailureType>
+        failed;
+
+    auto manager = std::make_shared<MockJobsManager>(registry->impl);
+    EXPECT_CALL(*manager, jobStarted()).WillRepeatedly(testing::ReturnRef(started));
+    EXPECT_CALL(*manager, jobStopped()).WillRepeatedly(testing::ReturnRef(stopped));
+    EXPECT_CALL(*manager, jobFailed()).WillRepeatedly(testing::ReturnRef(failed));
+    registry->impl->setJobs(manager);
+
+    registry->impl->setAppStores({std::make_shared<ubuntu::app_launch::app_store::Legacy>(registry->impl)});
+    auto checkpointer = std::make_shared<MockCheckpointer>();
+    registry->impl->setCheckpointer(checkpointer);
+
+    /* Single doesn't ask to be hibernated */
+    ubuntu::app_launch::AppID single{ubuntu::app_launch::AppID::Package::from_raw({}),
+                                     ubuntu::app_launch::AppID::AppName::from_raw("single"),
+                                     ubuntu::app_launch::AppID::Version::from_raw({})};
+    auto singleinst = std::make_shared<instanceMock>(
+        single, "application-legacy", std::string{}, std::vector<ubuntu::app_launch::Application::URL>{}, registry->impl);
+    EXPECT_CALL(*singleinst, stop()).Times(0);
+    EXPECT_CALL(*checkpointer, dump(testing::_, testing::_, testing::_, testing::_)).Times(0);
+
+    EXPECT_FALSE(singleinst->hibernate());
+
+    /* Hibernate does */
+    ubuntu::app_launch::AppID hibernate{ubuntu::app_launch::AppID::Package::from_raw({}),
+                                        ubuntu::app_launch::AppID::AppName::from_raw("hibernate"),
+                                        ubuntu::app_launch::AppID::Version::from_raw({})};
+    auto hibernateinst = std::make_shared<instanceMock>(
+        hibernate, "application-legacy", "1234", std::vector<ubuntu::app_launch::Application::URL>{}, registry->impl);
+    EXPECT_CALL(*hibernateinst, primaryPid()).WillRepeatedly(testing::Return(100));
+    EXPECT_CALL(*hibernateinst, pids()).WillRepeatedly(testing::Return(std::vector<pid_t>{}));
+    EXPECT_CALL(dynamic_cast<RegistryImplMock&>(*registry->impl), zgSendEvent(hibernate, ZEITGEIST_ZG_LEAVE_EVENT))
+        .WillRepeatedly(testing::Return());
+
+    /* Failed checkpoints leave it running, good ones stop it */
+    EXPECT_CALL(*checkpointer, dump(100, testing::_, testing::_, testing::_))
+        .WillOnce(testing::InvokeArgument<3>(false))
+        .WillOnce(testing::InvokeArgument<3>(true));
+    EXPECT_CALL(*manager, existing(hibernate, "application-legacy", "1234", testing::_))
+        .WillOnce(testing::Return(hibernateinst));
+    EXPECT_CALL(*hibernateinst, stop()).Times(1);
+
+    std::promise<bool> failedsave;
+    EXPECT_TRUE(hibernateinst->hibernate([&failedsave](bool saved) { failedsave.set_value(saved); }));
+    auto failedresult = failedsave.get_future();
+    ASSERT_EQ(std::future_status::ready, failedresult.wait_for(std::chrono::seconds{5}));
+    EXPECT_FALSE(failedresult.get());
+    EXPECT_FALSE(checkpointer->hasImage(hibernate));
+
+    std::promise<bool> goodsave;
+    EXPECT_TRUE(hibernateinst->hibernate([&goodsave](bool saved) { goodsave.set_value(saved); }));
+    auto goodresult = goodsave.get_future();
+    ASSERT_EQ(std::future_status::ready, goodresult.wait_for(std::chrono::seconds{5}));
+    EXPECT_TRUE(goodresult.get());
+    EXPECT_TRUE(checkpointer->hasImage(hibernate));
+
+    checkpointer->discard(hibernate);
+    g_unsetenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR");
+}
+
+TEST_F(JobBaseTest, lifecycleFilter)
+{
+    core::Signal<const std::string&, const std::string&, const std::string&> started;
+    core::Signal<const std::string&, const std::string&, const std::string&> stopped;
+    core::Signal<const std::string&, const std::string&, const std::string&, ubuntu::app_launch::Registry::FailureType>
+        failed;
+
+    auto manager = std::make_shared<MockJobsManager>(registry->impl);
+    EXPECT_CALL(*manager, jobStarted()).WillRepeatedly(testing::ReturnRef(started));
+    EXPECT_CALL(*manager, jobStopped()).WillRepeatedly(testing::ReturnRef(stopped));
+    EXPECT_CALL(*manager, jobFailed()).WillRepeatedly(testing::ReturnRef(failed));
+    registry->impl->setJobs(manager);
+
+    std::list<ubuntu::app_launch::Registry::LifecycleChange> exact;
+    auto exactsub = ubuntu::app_launch::Registry::subscribeLifecycle(
+        {simpleAppID(), "application-snap",
+         ubuntu::app_launch::Registry::LIFECYCLE_STARTED | ubuntu::app_launch::Registry::LIFECYCLE_FAILED},
+        [&exact](const ubuntu::app_launch::Registry::LifecycleChange& change) { exact.push_back(change); }, registry);
+
+    std::list<ubuntu::app_launch::Registry::LifecycleChange> pattern;
+    auto patternsub = ubuntu::app_launch::Registry::subscribeLifecycle(
+        {"package_*", {}, ubuntu::app_launch::Registry::LIFECYCLE_STOPPED},
+        [&pattern](const ubuntu::app_launch::Registry::LifecycleChange& change) { pattern.push_back(change); },
+        registry);
+
+    started("application-snap", simpleAppID(), "1");
+    started("application-legacy", simpleAppID(), "2");
+    started("application-snap", "other_app_1.2.3", "3");
+    stopped("application-snap", simpleAppID(), "1");
+    stopped("untrusted-helper", "package_helper_1", "4");
+    stopped("application-snap", "other_app_1.2.3", "3");
+    failed("application-snap", simpleAppID(), "5", ubuntu::app_launch::Registry::FailureType::START_FAILURE);
+
+    ASSERT_EQ(2u, exact.size());
+    EXPECT_EQ(ubuntu::app_launch::Registry::LIFECYCLE_STARTED, exact.front().event);
+    EXPECT_EQ("1", exact.front().instance);
+    EXPECT_EQ(ubuntu::app_launch::Registry::LIFECYCLE_FAILED, exact.back().event);
+    EXPECT_EQ(ubuntu::app_launch::Registry::FailureType::START_FAILURE, exact.back().reason);
+
+    ASSERT_EQ(2u, pattern.size());
+    EXPECT_EQ(std::string(simpleAppID()), pattern.front().appid);
+    EXPECT_EQ("untrusted-helper", pattern.back().job);
+    EXPECT_EQ("package_helper_1", pattern.back().appid);
+
+    /* Dropping the subscription stops the events */
+    exactsub.reset();
+    started("application-snap", simpleAppID(), "6");
+    EXPECT_EQ(2u, exact.size());
+
+    EXPECT_THROW(ubuntu::app_launch::Registry::subscribeLifecycle(
+                     {simpleAppID(), {}, 0}, [](const ubuntu::app_launch::Registry::LifecycleChange&) {}, registry),
+                 std::runtime_error);
+}
+
+TEST_F(JobBaseTest, lifecyclePause)
+{
+    auto manager = std::make_shared<MockJobsManager>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::vector<pid_t> pids{};
+    auto instance = simpleInstance();
+    EXPECT_CALL(*instance, pids()).WillRepeatedly(testing::Return(pids));
+    EXPECT_CALL(dynamic_cast<RegistryImplMock&>(*registry->impl), zgSendEvent(simpleAppID(), testing::_))
+        .WillRepeatedly(testing::Return());
+
+    /* The job comes from the instance */
+    std::vector<std::shared_ptr<ubuntu::app_launch::jobs::instance::Base>> none;
+    std::vector<std::shared_ptr<ubuntu::app_launch::jobs::instance::Base>> running{instance};
+    EXPECT_CALL(*manager, instances(testing::_, testing::_)).WillRepeatedly(testing::Return(none));
+    EXPECT_CALL(*manager, instances(simpleAppID(), "application-snap")).WillRepeatedly(testing::Return(running));
+
+    std::mutex lock;
+    std::list<ubuntu::app_launch::Registry::LifecycleChange> changes;
+    auto sub = ubuntu::app_launch::Registry::subscribeLifecycle(
+        {simpleAppID(), {}, ubuntu::app_launch::Registry::LIFECYCLE_PAUSED},
+        [&lock, &changes](const ubuntu::app_launch::Registry::LifecycleChange& change) {
+            std::lock_guard<std::mutex> guard(lock);
+            changes.push_back(change);
+        },
+        registry);
+
+    /* Other application jobs don't get it */
+    std::atomic<unsigned int> legacy{0};
+    auto legacysub = ubuntu::app_launch::Registry::subscribeLifecycle(
+        {simpleAppID(), "application-legacy", ubuntu::app_launch::Registry::LIFECYCLE_PAUSED},
+        [&legacy](const ubuntu::app_launch::Registry::LifecycleChange& change) { legacy++; }, registry);
+
+    instance->pause();
+    instance->resume();
+
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t{1}, std::function<std::size_t()>{[&lock, &changes] {
+                                  std::lock_guard<std::mutex> guard(lock);
+                                  return changes.size();
+                              }});
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        EXPECT_EQ(ubuntu::app_launch::Registry::LIFECYCLE_PAUSED, changes.front().event);
+        EXPECT_EQ("1234567890", changes.front().instance);
+        EXPECT_EQ("application-snap", changes.front().job);
+        EXPECT_EQ(ubuntu::app_launch::Registry::FailureType::NONE, changes.front().reason);
+    }
+    EXPECT_EQ(0u, legacy);
+
+    /* Once no one wants pauses they're dropped before looking anything up */
+    sub.reset();
+    legacysub.reset();
+    EXPECT_CALL(*manager, instances(testing::_, testing::_)).Times(0);
+
+    instance->pause();
+    pause(100);
+}
+
+TEST_F(JobBaseTest, instanceCaps)
+{
+    core::Signal<const std::string&, const std::string&, const std::string&> started;
+    core::Signal<const std::string&, const std::string&, const std::string&> stopped;
+    core::Signal<const std::string&, const std::string&, const std::string&, ubuntu::app_launch::Registry::FailureType>
+        failed;
+
+    auto manager = std::make_shared<MockJobsManager>(registry->impl);
+    EXPECT_CALL(*manager, jobStarted()).WillRepeatedly(testing::ReturnRef(started));
+    EXPECT_CALL(*manager, jobStopped()).WillRepeatedly(testing::ReturnRef(stopped));
+    EXPECT_CALL(*manager, jobFailed()).WillRepeatedly(testing::ReturnRef(failed));
+    registry->impl->setJobs(manager);
+
+    EXPECT_CALL(dynamic_cast<RegistryImplMock&>(*registry->impl), zgSendEvent(simpleAppID(), testing::_))
+        .WillRepeatedly(testing::Return());
+
+    ubuntu::app_launch::Registry::setInstanceCaps({0, {{simpleAppID(), 3}}}, registry);
+
+    std::mutex lock;
+    std::list<ubuntu::app_launch::Registry::LifecycleChange> changes;
+    auto sub = ubuntu::app_launch::Registry::subscribeLifecycle(
+        {simpleAppID(), {},
+         ubuntu::app_launch::Registry::LIFECYCLE_PAUSED | ubuntu::app_launch::Registry::LIFECYCLE_STOPPED},
+        [&lock, &changes](const ubuntu::app_launch::Registry::LifecycleChange& change) {
+            std::lock_guard<std::mutex> guard(lock);
+            changes.push_back(change);
+        },
+        registry);
+    auto changeCount = std::function<std::size_t()>{[&lock, &changes] {
+        std::lock_guard<std::mutex> guard(lock);
+        return changes.size();
+    }};
+
+    std::vector<std::shared_ptr<ubuntu::app_launch::jobs::instance::Base>> running;
+    std::vector<std::shared_ptr<instanceMock>> mocks;
+    for (const auto& instanceid : {"1", "2", "3"})
+    {
+        auto instance = std::make_shared<instanceMock>(simpleAppID(), "application-legacy", instanceid,
+                                                       std::vector<ubuntu::app_launch::Application::URL>{},
+                                                       registry->impl);
+        EXPECT_CALL(*instance, pids()).WillRepeatedly(testing::Return(std::vector<pid_t>{}));
+        running.push_back(instance);
+        mocks.push_back(instance);
+        started("application-legacy", simpleAppID(), instanceid);
+    }
+    EXPECT_CALL(*manager, instances(simpleAppID(), "application-legacy")).WillRepeatedly(testing::Return(running));
+
+    /* Under the cap nothing happens */
+    EXPECT_CALL(*manager, existing(testing::_, testing::_, testing::_, testing::_)).Times(0);
+    manager->retireInstances(simpleAppID(), "application-legacy");
+
+    /* Pause two, resuming the first again so that the second is the oldest */
+    mocks[0]->pause();
+    mocks[1]->pause();
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t{2}, changeCount);
+    mocks[0]->resume();
+    mocks[0]->pause();
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t{3}, changeCount);
+
+    std::atomic<bool> retired{false};
+    EXPECT_CALL(*mocks[1], stop()).WillOnce(testing::Invoke([&retired]() { retired = true; }));
+    EXPECT_CALL(*manager, existing(simpleAppID(), "application-legacy", "2", testing::_))
+        .WillOnce(testing::Return(mocks[1]));
+
+    manager->retireInstances(simpleAppID(), "application-legacy");
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>{[&retired] { return bool(retired); }});
+
+    /* Reported with its own reason */
+    stopped("application-legacy", simpleAppID(), "2");
+    stopped("application-legacy", simpleAppID(), "3");
+
+    std::lock_guard<std::mutex> guard(lock);
+    ASSERT_EQ(5u, changes.size());
+    auto retiredChange = *std::next(changes.begin(), 3);
+    EXPECT_EQ("2", retiredChange.instance);
+    EXPECT_EQ(ubuntu::app_launch::Registry::StopReason::RETIRED, retiredChange.stopReason);
+    EXPECT_EQ(ubuntu::app_launch::Registry::StopReason::STOPPED, changes.back().stopReason);
+}
+
+TEST_F(JobBaseTest, instanceRetiredElsewhere)
+{
+    core::Signal<const std::string&, const std::string&, const std::string&> started;
+    core::Signal<const std::string&, const std::string&, const std::string&> stopped;
+    core::Signal<const std::string&, const std::string&, const std::string&, ubuntu::app_launch::Registry::FailureType>
+        failed;
+
+    auto manager = std::make_shared<MockJobsManager>(registry->impl);
+    EXPECT_CALL(*manager, jobStarted()).WillRepeatedly(testing::ReturnRef(started));
+    EXPECT_CALL(*manager, jobStopped()).WillRepeatedly(testing::ReturnRef(stopped));
+    EXPECT_CALL(*manager, jobFailed()).WillRepeatedly(testing::ReturnRef(failed));
+    registry->impl->setJobs(manager);
+
+    std::vector<std::shared_ptr<ubuntu::app_launch::jobs::instance::Base>> none;
+    EXPECT_CALL(*manager, instances(testing::_, testing::_)).WillRepeatedly(testing::Return(none));
+
+    std::mutex lock;
+    std::list<ubuntu::app_launch::Registry::LifecycleChange> changes;
+    auto sub = ubuntu::app_launch::Registry::subscribeLifecycle(
+        {simpleAppID(), {},
+         ubuntu::app_launch::Registry::LIFECYCLE_PAUSED | ubuntu::app_launch::Registry::LIFECYCLE_STOPPED},
+        [&lock, &changes](const ubuntu::app_launch::Registry::LifecycleChange& change) {
+            std::lock_guard<std::mutex> guard(lock);
+            changes.push_back(change);
+        },
+        registry);
+    auto changeCount = std::function<std::size_t()>{[&lock, &changes] {
+        std::lock_guard<std::mutex> guard(lock);
+        return changes.size();
+    }};
+
+    /* Another process retires an instance, then pauses one so we know it got here */
+    auto address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
+    auto other = g_dbus_connection_new_for_address_sync(
+        address, GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                      G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr, nullptr, nullptr);
+    g_free(address);
+    ASSERT_NE(nullptr, other);
+
+    g_dbus_connection_emit_signal(other, nullptr, "/", "com.canonical.UbuntuAppLaunch", "ApplicationRetired",
+                                  g_variant_new("(ss)", std::string(simpleAppID()).c_str(), "2"), nullptr);
+    g_dbus_connection_emit_signal(other, nullptr, "/", "com.canonical.UbuntuAppLaunch", "ApplicationPaused",
+                                  g_variant_new("(ss@at)", std::string(simpleAppID()).c_str(), "3",
+                                                g_variant_new_array(G_VARIANT_TYPE_UINT64, nullptr, 0)),
+                                  nullptr);
+    g_dbus_connection_flush_sync(other, nullptr, nullptr);
+    g_object_unref(other);
+
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t{1}, changeCount);
+
+    stopped("application-legacy", simpleAppID(), "2");
+    stopped("application-legacy", simpleAppID(), "3");
+
+    std::lock_guard<std::mutex> guard(lock);
+    ASSERT_EQ(3u, changes.size());
+    auto retiredChange = *std::next(changes.begin(), 1);
+    EXPECT_EQ("2", retiredChange.instance);
+    EXPECT_EQ(ubuntu::app_launch::Registry::StopReason::RETIRED, retiredChange.stopReason);
+    EXPECT_EQ(ubuntu::app_launch::Registry::StopReason::STOPPED, changes.back().stopReason);
+}
@@ -24,7 +24,15 @@
 #include "registry-mock.h"
 #include "systemd-mock.h"
 
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <glib/gstdio.h>
+#include <mutex>
+#include <thread>
+
 #define CGROUP_DIR (CMAKE_BINARY_DIR "/systemd-cgroups")
+#define DBUS_SERVICES_DIR (CMAKE_BINARY_DIR "/jobs-systemd-dbus-services")
 
 class JobsSystemd : public EventuallyFixture
 {
@@ -93,6 +101,48 @@ protected:
                 ubuntu::app_launch::AppID::AppName::from_raw("multiple"),
                 ubuntu::app_launch::AppID::Version::from_raw({})};
     }
+
+    /* Launch environment for a job that runs @exec */
+    std::function<std::list<std::pair<std::string, std::string>>()> execEnv(const std::string &exec = "sh")
+    {
+        return [exec]() -> std::list<std::pair<std::string, std::string>> { return {{"APP_EXEC", exec}}; };
+    }
+
+    /* Wait for systemd to be asked to start @count units */
+    std::list<SystemdMock::TransientUnit> waitForUnits(unsigned int count = 1)
+    {
+        std::list<SystemdMock::TransientUnit> units;
+        EXPECT_EVENTUALLY_FUNC_EQ(count, std::function<unsigned int()>([&]() {
+                                      units = systemd->unitCalls();
+                                      return units.size();
+                                  }));
+        return units;
+    }
+
+    /* Round trip to the systemd mock, everything sent to it or from it
+       on the session bus before this has been handled once it returns */
+    void pingSystemd()
+    {
+        auto reply = g_dbus_connection_call_sync(bus, "org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                                 "org.freedesktop.DBus.Peer", "Ping", nullptr, nullptr,
+                                                 G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+        ASSERT_NE(nullptr, reply);
+        g_variant_unref(reply);
+    }
+
+    /* Wait for the registry to handle what systemd has sent it, and for
+       systemd to handle what the registry sent back. Each round covers
+       one call and its reply, so tests can check that something didn't
+       happen without sleeping. */
+    void settle(unsigned int rounds = 1)
+    {
+        for (unsigned int i = 0; i < rounds; i++)
+        {
+            pingSystemd();
+            registry->impl->thread.executeOnThread<bool>([]() { return true; });
+        }
+        pingSystemd();
+    }
 };
 
 /* Make sure we can build an object and destroy it */
@@ -145,6 +195,105 @@ TEST_F(JobsSystemd, RunningApps)
     EXPECT_EQ(2u, minstances.size());
 }
 
+/* Use the caller's context instead of a thread */
+TEST_F(JobsSystemd, CallerContext)
+{
+    auto context = std::shared_ptr<GMainContext>(g_main_context_ref(g_main_context_default()), g_main_context_unref);
+    auto ctxregistry = std::make_shared<RegistryMock>(context);
+    ctxregistry->impl->setAppStores({std::make_shared<ubuntu::app_launch::app_store::Legacy>(ctxregistry->impl)});
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(ctxregistry->impl);
+    ctxregistry->impl->setJobs(manager);
+
+    /* Work is done right here, no thread switching */
+    auto testthread = std::this_thread::get_id();
+    EXPECT_EQ(testthread, ctxregistry->impl->thread.executeOnThread<std::thread::id>(
+                              []() { return std::this_thread::get_id(); }));
+
+    auto apps = manager->runningApps();
+    EXPECT_EQ(2u, apps.size());
+
+    /* Other threads wait for us to dispatch their work, even when we
+       aren't iterating the context and they could grab it */
+    auto otherthread = std::async(std::launch::async, [&ctxregistry]() {
+        return ctxregistry->impl->thread.executeOnThread<std::thread::id>([]() { return std::this_thread::get_id(); });
+    });
+    EXPECT_EVENTUALLY_FUTURE_EQ(testthread, std::move(otherthread));
+
+    /* Signals come in while the caller's context is dispatched */
+    std::promise<std::thread::id> signalthread;
+    bool dispatching{false};
+    manager->appStarted().connect([&](const std::shared_ptr<ubuntu::app_launch::Application> &app,
+                                      const std::shared_ptr<ubuntu::app_launch::Application::Instance> &inst) {
+        dispatching = g_main_context_is_owner(context.get()) && g_main_depth() > 0;
+        signalthread.set_value(std::this_thread::get_id());
+    });
+
+    systemd->managerEmitNew(SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "1234", 1, {}}),
+                            "/foo");
+
+    EXPECT_EVENTUALLY_FUTURE_EQ(testthread, signalthread.get_future());
+    EXPECT_TRUE(dispatching);
+
+    ctxregistry.reset();
+}
+
+/* Work that is dropped at shutdown wakes up whoever is waiting on it */
+TEST_F(JobsSystemd, CallerContextShutdown)
+{
+    auto context = std::shared_ptr<GMainContext>(g_main_context_new(), g_main_context_unref);
+    auto thread = std::make_shared<GLib::ContextThread>([]() {}, []() {}, context);
+
+    std::promise<void> queued;
+    auto waiter = std::async(std::launch::async, [&thread, &queued]() {
+        queued.set_value();
+        return thread->executeOnThread<bool>([]() { return true; });
+    });
+
+    /* Give it a chance to get queued, it errors either way */
+    queued.get_future().wait();
+    pause(50);
+
+    thread->quit();
+    while (g_main_context_iteration(context.get(), FALSE))
+    {
+    }
+
+    EXPECT_THROW(waiter.get(), std::runtime_error);
+}
+
+/* The thread iterating the context can't wait on itself, so it gets an
+   error when it can't do the work right away */
+TEST_F(JobsSystemd, CallerContextOwnerBlocked)
+{
+    auto context = std::shared_ptr<GMainContext>(g_main_context_new(), g_main_context_unref);
+    auto thread = std::make_shared<GLib::ContextThread>([]() {}, []() {}, context);
+
+    /* Someone else has the context */
+    std::promise<void> acquired;
+    std::promise<void> release;
+    auto holder = std::async(std::launch::async, [&context, &acquired, &release]() {
+        g_main_context_acquire(context.get());
+        acquired.set_value();
+        release.get_future().wait();
+        g_main_context_release(context.get());
+    });
+    acquired.get_future().wait();
+
+    EXPECT_THROW(thread->executeOnThread<bool>([]() { return true; }), std::runtime_error);
+
+    release.set_value();
+    holder.wait();
+    EXPECT_TRUE(thread->executeOnThread<bool>([]() { return true; }));
+
+    /* Or we're shutting down */
+    thread->quit();
+    EXPECT_THROW(thread->executeOnThread<bool>([]() { return true; }), std::runtime_error);
+
+    while (g_main_context_iteration(context.get(), FALSE))
+    {
+    }
+}
+
 /* Check to make sure we're getting the user bus path correctly */
 TEST_F(JobsSystemd, UserBusPath)
 {
@@ -293,6 +442,680 @@ TEST_F(JobsSystemd, LaunchJob)
               units.begin()->environment.find("ARBITRARY_KEY=EVEN_MORE_ARBITRARY_VALUE"));
 }
 
+/* Launching with URLs passes them through without quoting */
+TEST_F(JobsSystemd, LaunchJobURLs)
+{
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::function<std::list<std::pair<std::string, std::string>>()> getenvfunc =
+        [&]() -> std::list<std::pair<std::string, std::string>> { return {{"APP_EXEC", "sh %U"}}; };
+
+    std::vector<ubuntu::app_launch::Application::URL> urls{
+        ubuntu::app_launch::Application::URL::from_raw("http://ubuntu.com"),
+        ubuntu::app_launch::Application::URL::from_raw("file:///home/test/it's a file.png")};
+
+    manager->launch(multipleAppID(), defaultJobName(), "123", urls,
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, getenvfunc);
+
+    std::list<SystemdMock::TransientUnit> units;
+    EXPECT_EVENTUALLY_FUNC_LT(0u, std::function<unsigned int()>([&]() {
+                                  units = systemd->unitCalls();
+                                  return units.size();
+                              }));
+
+    std::list<std::string> execline{"sh", "http://ubuntu.com", "file:///home/test/it's a file.png"};
+    EXPECT_EQ(execline, units.begin()->execline);
+}
+
+/* Launching with more URLs than the threshold puts them in a file */
+TEST_F(JobsSystemd, LaunchJobURLsFile)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_URIS_FILE_THRESHOLD", "10", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::function<std::list<std::pair<std::string, std::string>>()> getenvfunc =
+        [&]() -> std::list<std::pair<std::string, std::string>> {
+        return {{"APP_EXEC", "sh %U"}, {"APP_URIS_FILE", "1"}};
+    };
+
+    std::vector<ubuntu::app_launch::Application::URL> urls{
+        ubuntu::app_launch::Application::URL::from_raw("http://ubuntu.com"),
+        ubuntu::app_launch::Application::URL::from_raw("http://slashdot.org")};
+
+    manager->launch(multipleAppID(), defaultJobName(), "123", urls,
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, getenvfunc);
+
+    std::list<SystemdMock::TransientUnit> units;
+    EXPECT_EVENTUALLY_FUNC_LT(0u, std::function<unsigned int()>([&]() {
+                                  units = systemd->unitCalls();
+                                  return units.size();
+                              }));
+
+    /* URLs aren't on the command line */
+    std::list<std::string> execline{"sh"};
+    EXPECT_EQ(execline, units.begin()->execline);
+
+    /* But they are in the file */
+    auto fileenv = std::find_if(units.begin()->environment.begin(), units.begin()->environment.end(),
+                                [](const std::string &env) { return env.find("UBUNTU_APP_LAUNCH_URIS_FILE=") == 0; });
+    ASSERT_NE(units.begin()->environment.end(), fileenv);
+
+    auto path = fileenv->substr(std::string{"UBUNTU_APP_LAUNCH_URIS_FILE="}.size());
+    gchar *contents = nullptr;
+    ASSERT_TRUE(g_file_get_contents(path.c_str(), &contents, nullptr, nullptr));
+    EXPECT_STREQ("http://ubuntu.com\nhttp://slashdot.org\n", contents);
+    g_free(contents);
+
+    /* And the unit removes it when it stops */
+    std::list<std::string> stoppost{"rm", "-f", path};
+    EXPECT_EQ(stoppost, units.begin()->stoppost);
+
+    g_unlink(path.c_str());
+    g_unsetenv("UBUNTU_APP_LAUNCH_URIS_FILE_THRESHOLD");
+}
+
+/* Applications that don't read the file get their URLs on the command line */
+TEST_F(JobsSystemd, LaunchJobURLsFileNotSupported)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_URIS_FILE_THRESHOLD", "10", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::function<std::list<std::pair<std::string, std::string>>()> getenvfunc =
+        [&]() -> std::list<std::pair<std::string, std::string>> { return {{"APP_EXEC", "sh %U"}}; };
+
+    std::vector<ubuntu::app_launch::Application::URL> urls{
+        ubuntu::app_launch::Application::URL::from_raw("http://ubuntu.com"),
+        ubuntu::app_launch::Application::URL::from_raw("http://slashdot.org")};
+
+    manager->launch(multipleAppID(), defaultJobName(), "123", urls,
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, getenvfunc);
+
+    std::list<SystemdMock::TransientUnit> units;
+    EXPECT_EVENTUALLY_FUNC_LT(0u, std::function<unsigned int()>([&]() {
+                                  units = systemd->unitCalls();
+                                  return units.size();
+                              }));
+
+    std::list<std::string> execline{"sh", "http://ubuntu.com", "http://slashdot.org"};
+    EXPECT_EQ(execline, units.begin()->execline);
+    EXPECT_TRUE(units.begin()->stoppost.empty());
+    EXPECT_EQ(units.begin()->environment.end(),
+              std::find_if(units.begin()->environment.begin(), units.begin()->environment.end(),
+                           [](const std::string &env) { return env.find("UBUNTU_APP_LAUNCH_URIS_FILE=") == 0; }));
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_URIS_FILE_THRESHOLD");
+}
+
+/* A launch that goes to a running instance doesn't leave a file behind */
+TEST_F(JobsSystemd, LaunchJobURLsFileExisting)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_URIS_FILE_THRESHOLD", "10", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::function<std::list<std::pair<std::string, std::string>>()> getenvfunc =
+        [&]() -> std::list<std::pair<std::string, std::string>> {
+        return {{"APP_EXEC", "sh %U"}, {"APP_URIS_FILE", "1"}};
+    };
+
+    std::vector<ubuntu::app_launch::Application::URL> urls{
+        ubuntu::app_launch::Application::URL::from_raw("http://ubuntu.com"),
+        ubuntu::app_launch::Application::URL::from_raw("http://slashdot.org")};
+
+    /* Already running in the mock */
+    manager->launch(singleAppID(), defaultJobName(), {}, urls, ubuntu::app_launch::jobs::manager::launchMode::STANDARD,
+                    getenvfunc);
+
+    std::list<SystemdMock::TransientUnit> units;
+    EXPECT_EVENTUALLY_FUNC_LT(0u, std::function<unsigned int()>([&]() {
+                                  units = systemd->unitCalls();
+                                  return units.size();
+                              }));
+
+    auto fileenv = std::find_if(units.begin()->environment.begin(), units.begin()->environment.end(),
+                                [](const std::string &env) { return env.find("UBUNTU_APP_LAUNCH_URIS_FILE=") == 0; });
+    ASSERT_NE(units.begin()->environment.end(), fileenv);
+
+    auto path = fileenv->substr(std::string{"UBUNTU_APP_LAUNCH_URIS_FILE="}.size());
+    EXPECT_EVENTUALLY_FUNC_EQ(false, std::function<bool()>([&]() {
+                                  return g_file_test(path.c_str(), G_FILE_TEST_EXISTS) == TRUE;
+                              }));
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_URIS_FILE_THRESHOLD");
+}
+
+/* Launching a hibernated app restores it */
+TEST_F(JobsSystemd, LaunchRestoresCheckpoint)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR", CMAKE_BINARY_DIR "/jobs-systemd-checkpoints", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+    auto checkpointer = std::make_shared<MockCheckpointer>();
+    registry->impl->setCheckpointer(checkpointer);
+
+    bool saved{false};
+    EXPECT_CALL(*checkpointer, dump(1234, testing::_, testing::_, testing::_))
+        .WillOnce(testing::InvokeArgument<3>(true));
+    checkpointer->checkpoint(multipleAppID(), 1234, nullptr, [&saved](bool result) { saved = result; });
+    ASSERT_TRUE(saved);
+
+    auto unitname = SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "123", 1, {}});
+    auto restoredir = checkpointer->restoreDir(unitname);
+    EXPECT_CALL(*checkpointer, restoreCommand(restoredir))
+        .WillOnce(testing::Return(std::vector<std::string>{"sh", "restore", restoredir}));
+
+    std::function<std::list<std::pair<std::string, std::string>>()> getenvfunc =
+        [&]() -> std::list<std::pair<std::string, std::string>> { return {{"APP_EXEC", "sh"}}; };
+
+    manager->launch(multipleAppID(), defaultJobName(), "123", {},
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, getenvfunc);
+
+    std::list<SystemdMock::TransientUnit> units;
+    EXPECT_EVENTUALLY_FUNC_LT(0u, std::function<unsigned int()>([&]() {
+                                  units = systemd->unitCalls();
+                                  return units.size();
+                              }));
+
+    std::list<std::string> execline{"sh", "restore", restoredir};
+    EXPECT_EQ(execline, units.begin()->execline);
+    EXPECT_FALSE(checkpointer->hasImage(multipleAppID()));
+
+    /* The image is cleaned up with the unit */
+    systemd->managerEmitRemoved(unitname, "/foo");
+    EXPECT_EVENTUALLY_FUNC_EQ(false, std::function<bool()>([&]() {
+                                  return g_file_test(restoredir.c_str(), G_FILE_TEST_EXISTS) == TRUE;
+                              }));
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR");
+}
+
+/* A launch that finds the app running leaves the image for later */
+TEST_F(JobsSystemd, LaunchExistingKeepsCheckpoint)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR", CMAKE_BINARY_DIR "/jobs-systemd-checkpoints", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+    auto checkpointer = std::make_shared<MockCheckpointer>();
+    registry->impl->setCheckpointer(checkpointer);
+
+    bool saved{false};
+    EXPECT_CALL(*checkpointer, dump(1234, testing::_, testing::_, testing::_))
+        .WillOnce(testing::InvokeArgument<3>(true));
+    checkpointer->checkpoint(singleAppID(), 1234, nullptr, [&saved](bool result) { saved = result; });
+    ASSERT_TRUE(saved);
+
+    EXPECT_CALL(*checkpointer, restoreCommand(testing::_))
+        .WillOnce(testing::Return(std::vector<std::string>{"sh", "restore"}));
+
+    std::function<std::list<std::pair<std::string, std::string>>()> getenvfunc =
+        [&]() -> std::list<std::pair<std::string, std::string>> { return {{"APP_EXEC", "sh"}}; };
+
+    /* Single is already running so systemd refuses the new unit */
+    manager->launch(singleAppID(), defaultJobName(), {}, {}, ubuntu::app_launch::jobs::manager::launchMode::STANDARD,
+                    getenvfunc);
+
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, std::function<unsigned int()>([&]() { return systemd->unitCalls().size(); }));
+    EXPECT_EVENTUALLY_FUNC_EQ(true,
+                              std::function<bool()>([&]() { return checkpointer->hasImage(singleAppID()); }));
+
+    checkpointer->discard(singleAppID());
+    g_unsetenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR");
+}
+
+/* Launching over a unit that is dying waits for it to go away */
+TEST_F(JobsSystemd, LaunchDyingUnit)
+{
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    SystemdMock::Instance single{defaultJobName(), std::string{singleAppID()}, {}, 5, {1, 2, 3, 4, 5}};
+    auto unitname = SystemdMock::instanceName(single);
+    systemd->managerSetActiveState(single, "deactivating");
+
+    manager->launch(singleAppID(), defaultJobName(), {}, {}, ubuntu::app_launch::jobs::manager::launchMode::STANDARD,
+                    execEnv());
+
+    waitForUnits(1);
+
+    /* Once it has seen the old one dying it waits for it to go */
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([&]() {
+                                  auto states = systemd->stateCalls();
+                                  return std::find(states.begin(), states.end(), unitname) != states.end();
+                              }));
+    settle();
+    EXPECT_EQ(1u, systemd->unitCalls().size());
+
+    /* Now we try again */
+    systemd->managerEmitRemoved(unitname, SystemdMock::instancePath(single));
+
+    auto units = waitForUnits(2);
+    EXPECT_EQ(unitname, units.rbegin()->name);
+}
+
+/* The image a dying unit restored from is cleaned up even when a new
+   instance is waiting to take its place */
+TEST_F(JobsSystemd, LaunchDyingUnitRestored)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR", CMAKE_BINARY_DIR "/jobs-systemd-checkpoints", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+    auto checkpointer = std::make_shared<MockCheckpointer>();
+    registry->impl->setCheckpointer(checkpointer);
+
+    SystemdMock::Instance single{defaultJobName(), std::string{singleAppID()}, {}, 5, {1, 2, 3, 4, 5}};
+    auto unitname = SystemdMock::instanceName(single);
+    systemd->managerSetActiveState(single, "deactivating");
+
+    /* The old unit was restored from an image */
+    auto restoredir = checkpointer->restoreDir(unitname);
+    ASSERT_EQ(0, g_mkdir_with_parents(restoredir.c_str(), 0700));
+
+    /* Launching with URLs never restores */
+    std::vector<ubuntu::app_launch::Application::URL> urls{
+        ubuntu::app_launch::Application::URL::from_raw("http://ubuntu.com")};
+    manager->launch(singleAppID(), defaultJobName(), {}, urls,
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, execEnv("sh %U"));
+
+    waitForUnits(1);
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([&]() {
+                                  auto states = systemd->stateCalls();
+                                  return std::find(states.begin(), states.end(), unitname) != states.end();
+                              }));
+    settle();
+
+    systemd->managerEmitRemoved(unitname, SystemdMock::instancePath(single));
+
+    waitForUnits(2);
+    EXPECT_EVENTUALLY_FUNC_EQ(false, std::function<bool()>([&]() {
+                                  return g_file_test(restoredir.c_str(), G_FILE_TEST_EXISTS) == TRUE;
+                              }));
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_CHECKPOINT_DIR");
+}
+
+/* Launching over a failed unit resets it so it can go away */
+TEST_F(JobsSystemd, LaunchFailedUnit)
+{
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    SystemdMock::Instance single{defaultJobName(), std::string{singleAppID()}, {}, 5, {1, 2, 3, 4, 5}};
+    systemd->managerSetActiveState(single, "failed");
+
+    manager->launch(singleAppID(), defaultJobName(), {}, {}, ubuntu::app_launch::jobs::manager::launchMode::STANDARD,
+                    execEnv());
+
+    std::list<std::string> resets;
+    EXPECT_EVENTUALLY_FUNC_LT(0u, std::function<unsigned int()>([&]() {
+                                  resets = systemd->resetCalls();
+                                  return resets.size();
+                              }));
+
+    EXPECT_EQ(SystemdMock::instanceName(single), *resets.begin());
+}
+
+/* A unit that never goes away fails the launch */
+TEST_F(JobsSystemd, LaunchDyingUnitTimeout)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_RELAUNCH_TIMEOUT", "100", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    SystemdMock::Instance single{defaultJobName(), std::string{singleAppID()}, {}, 5, {1, 2, 3, 4, 5}};
+    systemd->managerSetActiveState(single, "deactivating");
+
+    ubuntu::app_launch::AppID failedappid;
+    ubuntu::app_launch::Registry::FailureType failedtype{ubuntu::app_launch::Registry::FailureType::CRASH};
+    manager->appFailed().connect([&](const std::shared_ptr<ubuntu::app_launch::Application> &app,
+                                     const std::shared_ptr<ubuntu::app_launch::Application::Instance> &inst,
+                                     ubuntu::app_launch::Registry::FailureType type) {
+        failedtype = type;
+        failedappid = app->appId();
+    });
+
+    manager->launch(singleAppID(), defaultJobName(), {}, {}, ubuntu::app_launch::jobs::manager::launchMode::STANDARD,
+                    execEnv());
+
+    EXPECT_EVENTUALLY_EQ(singleAppID(), failedappid);
+    EXPECT_EQ(ubuntu::app_launch::Registry::FailureType::START_FAILURE, failedtype);
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_RELAUNCH_TIMEOUT");
+}
+
+/* Applications start boosted and go back to normal weights when
+   they don't get ready in time */
+TEST_F(JobsSystemd, LaunchBoostTimeout)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST", "1", TRUE);
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_TIMEOUT", "100", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    manager->launch(multipleAppID(), defaultJobName(), "123", {},
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, execEnv());
+
+    auto units = waitForUnits(1);
+
+    auto unitname = SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "123", 1, {}});
+    EXPECT_EQ(1000u, units.begin()->weights["CPUWeight"]);
+    EXPECT_EQ(1000u, units.begin()->weights["IOWeight"]);
+
+    std::list<SystemdMock::UnitProperties> props;
+    EXPECT_EVENTUALLY_FUNC_LT(0u, std::function<unsigned int()>([&]() {
+                                  props = systemd->propertiesCalls();
+                                  return props.size();
+                              }));
+
+    EXPECT_EQ(unitname, props.begin()->name);
+    EXPECT_TRUE(props.begin()->runtime);
+    EXPECT_EQ(100u, props.begin()->weights["CPUWeight"]);
+    EXPECT_EQ(100u, props.begin()->weights["IOWeight"]);
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST");
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_TIMEOUT");
+}
+
+/* The boost ends once the application is ready */
+TEST_F(JobsSystemd, LaunchBoostReady)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST", "1", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    manager->launch(multipleAppID(), defaultJobName(), "123", {},
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, execEnv());
+
+    waitForUnits(1);
+    EXPECT_EQ(0u, systemd->propertiesCalls().size());
+
+    manager->unitReady(multipleAppID(), defaultJobName(), "123");
+
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, std::function<unsigned int()>([&]() { return systemd->propertiesCalls().size(); }));
+
+    /* Only lowered once */
+    manager->unitReady(multipleAppID(), defaultJobName(), "123");
+    settle();
+    EXPECT_EQ(1u, systemd->propertiesCalls().size());
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST");
+}
+
+/* Units we boosted get lowered if we go away first */
+TEST_F(JobsSystemd, LaunchBoostShutdown)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST", "1", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    manager->launch(multipleAppID(), defaultJobName(), "123", {},
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, execEnv());
+
+    waitForUnits(1);
+    settle();
+    EXPECT_EQ(0u, systemd->propertiesCalls().size());
+
+    manager.reset();
+    registry.reset();
+
+    std::list<SystemdMock::UnitProperties> props;
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, std::function<unsigned int()>([&]() {
+                                  props = systemd->propertiesCalls();
+                                  return props.size();
+                              }));
+    EXPECT_EQ(SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "123", 1, {}}),
+              props.begin()->name);
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST");
+}
+
+/* No boost unless it is turned on */
+TEST_F(JobsSystemd, LaunchNoBoost)
+{
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    manager->launch(multipleAppID(), defaultJobName(), "456", {},
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, execEnv());
+
+    auto units = waitForUnits(1);
+    EXPECT_TRUE(units.begin()->weights.empty());
+
+    manager->unitReady(multipleAppID(), defaultJobName(), "456");
+    settle();
+    EXPECT_EQ(0u, systemd->propertiesCalls().size());
+}
+
+/* Or when it is turned on without any weights */
+TEST_F(JobsSystemd, LaunchNoBoostWeights)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST", "1", TRUE);
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_CPU_WEIGHT", "0", TRUE);
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_IO_WEIGHT", "0", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    manager->launch(multipleAppID(), defaultJobName(), "456", {},
+                    ubuntu::app_launch::jobs::manager::launchMode::STANDARD, execEnv());
+
+    auto units = waitForUnits(1);
+    EXPECT_TRUE(units.begin()->weights.empty());
+
+    manager->unitReady(multipleAppID(), defaultJobName(), "456");
+    settle();
+    EXPECT_EQ(0u, systemd->propertiesCalls().size());
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST");
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_CPU_WEIGHT");
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST_IO_WEIGHT");
+}
+
+/* Launching into a running unit doesn't change its weights */
+TEST_F(JobsSystemd, LaunchExistingNoBoost)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST", "1", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    manager->launch(singleAppID(), defaultJobName(), {}, {}, ubuntu::app_launch::jobs::manager::launchMode::STANDARD,
+                    execEnv());
+
+    waitForUnits(1);
+    settle();
+
+    manager->unitReady(singleAppID(), defaultJobName(), {});
+    settle();
+    EXPECT_EQ(0u, systemd->propertiesCalls().size());
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST");
+}
+
+/* Units someone else launched are left alone, we can't tell whether
+   they were boosted */
+TEST_F(JobsSystemd, LaunchBoostNotObserved)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST", "1", TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::atomic<unsigned int> starts{0};
+    manager->jobStarted().connect(
+        [&starts](const std::string &, const std::string &, const std::string &) { starts++; });
+
+    auto unitname = SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "1234", 1, {}});
+    systemd->managerEmitNew(unitname, "/foo");
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, std::function<unsigned int()>([&starts]() { return starts.load(); }));
+
+    manager->unitReady(multipleAppID(), defaultJobName(), "1234");
+    settle();
+    EXPECT_EQ(0u, systemd->propertiesCalls().size());
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_SYSTEMD_BOOST");
+}
+
+/* Helpers with endpoints get a socket unit that holds their service unit */
+TEST_F(JobsSystemd, ActivateHelper)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_DBUS_SERVICES_DIR", DBUS_SERVICES_DIR, TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::vector<ubuntu::app_launch::Helper::Endpoint> endpoints{
+        {ubuntu::app_launch::Helper::Endpoint::Kind::SOCKET, "/tmp/helper-socket"},
+        {ubuntu::app_launch::Helper::Endpoint::Kind::DBUS_NAME, "com.example.Helper"}};
+
+    /* Applications can't be activated */
+    EXPECT_THROW(manager->activate(multipleAppID(), defaultJobName(), "123", {}, endpoints, execEnv()),
+                 std::runtime_error);
+    /* Need an endpoint */
+    EXPECT_THROW(manager->activate(multipleAppID(), "untrusted-type", "123", {}, {}, execEnv()), std::runtime_error);
+
+    auto inst = manager->activate(multipleAppID(), "untrusted-type", "123", {}, endpoints, execEnv());
+    EXPECT_TRUE(bool(inst));
+
+    auto units = waitForUnits(2);
+
+    SystemdMock::Instance helper{"untrusted-type", std::string{multipleAppID()}, "123", 1, {}};
+    auto servicename = SystemdMock::instanceName(helper);
+    auto socketname = "ubuntu-app-launch--untrusted-type--" + std::string{multipleAppID()} + "--123.socket";
+
+    auto socket = units.front();
+    EXPECT_EQ(socketname, socket.name);
+    EXPECT_EQ(std::list<std::string>{"/tmp/helper-socket"}, socket.listen);
+
+    auto service = units.back();
+    EXPECT_EQ(servicename, service.name);
+    EXPECT_EQ(socketname, service.auxof);
+    EXPECT_EQ("com.example.Helper", service.busname);
+    EXPECT_EQ("/bin/sh", service.execpath);
+
+    /* Bus knows about the name */
+    auto busfile = std::string{DBUS_SERVICES_DIR} + "/com.example.Helper.service";
+    gchar *cbusfile = nullptr;
+    ASSERT_TRUE(g_file_get_contents(busfile.c_str(), &cbusfile, nullptr, nullptr));
+    EXPECT_NE(nullptr, strstr(cbusfile, ("SystemdService=" + servicename).c_str()));
+    g_free(cbusfile);
+
+    /* Stopping takes down the socket first, even from another manager
+       that didn't set it up, without looking it up first. The mock
+       doesn't know the service so it fails to stop that. */
+    auto othermanager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    EXPECT_THROW(othermanager->stopUnit(multipleAppID(), "untrusted-type", "123"), std::runtime_error);
+
+    auto stopcalls = systemd->stopCalls();
+    ASSERT_EQ(2u, stopcalls.size());
+    EXPECT_EQ(socketname, stopcalls.front());
+    EXPECT_EQ(servicename, stopcalls.back());
+
+    auto statecalls = systemd->stateCalls();
+    EXPECT_EQ(statecalls.end(), std::find(statecalls.begin(), statecalls.end(), socketname));
+
+    /* The service unit going away isn't enough, the socket could start it */
+    systemd->managerEmitRemoved(servicename, SystemdMock::instancePath(helper));
+    settle();
+    EXPECT_TRUE(g_file_test(busfile.c_str(), G_FILE_TEST_EXISTS));
+
+    /* Cleaned up when the socket goes away */
+    systemd->managerEmitRemoved(socketname, "/socket");
+    EXPECT_EVENTUALLY_FUNC_EQ(false, std::function<bool()>([&]() {
+                                  return g_file_test(busfile.c_str(), G_FILE_TEST_EXISTS) == TRUE;
+                              }));
+
+    g_unsetenv("UBUNTU_APP_LAUNCH_DBUS_SERVICES_DIR");
+}
+
+/* A helper with only a D-Bus name still gets a socket to hold its unit */
+TEST_F(JobsSystemd, ActivateHelperBusOnly)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_DBUS_SERVICES_DIR", DBUS_SERVICES_DIR, TRUE);
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::vector<ubuntu::app_launch::Helper::Endpoint> badname{
+        {ubuntu::app_launch::Helper::Endpoint::Kind::DBUS_NAME, ":1.42"}};
+    EXPECT_THROW(manager->activate(multipleAppID(), "untrusted-type", "123", {}, badname, execEnv()),
+                 std::runtime_error);
+
+    manager->activate(multipleAppID(), "untrusted-type", "123", {},
+                      {{ubuntu::app_launch::Helper::Endpoint::Kind::DBUS_NAME, "com.example.BusOnly"}}, execEnv());
+
+    auto units = waitForUnits(2);
+
+    ASSERT_EQ(1u, units.front().listen.size());
+    EXPECT_EQ(0u, units.front().listen.front().find(std::string{g_get_user_runtime_dir()} + "/ubuntu-app-launch/"));
+    EXPECT_EQ("com.example.BusOnly", units.back().busname);
+
+    g_unlink(DBUS_SERVICES_DIR "/com.example.BusOnly.service");
+    g_unsetenv("UBUNTU_APP_LAUNCH_DBUS_SERVICES_DIR");
+}
+
+/* Crashed apps get restarted with the restart policy */
+TEST_F(JobsSystemd, RestartPolicy)
+{
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    manager->setRestartPolicy({true, 1, std::chrono::milliseconds{10}, std::chrono::milliseconds{100},
+                               std::chrono::seconds{60}});
+
+    /* The policy has already decided by the time we hear about the failure */
+    std::atomic<unsigned int> failures{0};
+    std::atomic<unsigned int> starts{0};
+    manager->jobFailed().connect([&failures](const std::string &, const std::string &, const std::string &,
+                                             ubuntu::app_launch::Registry::FailureType) { failures++; });
+    manager->jobStarted().connect(
+        [&starts](const std::string &, const std::string &, const std::string &) { starts++; });
+
+    SystemdMock::Instance multiple{defaultJobName(), std::string{multipleAppID()}, "1234567890", 1, {}};
+    systemd->managerEmitFailed(multiple);
+
+    auto isRestart = [this](const SystemdMock::TransientUnit &unit) {
+        return unit.name.find("ubuntu-app-launch--" + defaultJobName() + "--" + std::string{multipleAppID()} +
+                              "--") == 0;
+    };
+
+    EXPECT_EVENTUALLY_FUNC_EQ(1, std::function<int()>([&]() {
+                                  auto units = systemd->unitCalls();
+                                  return int(std::count_if(units.begin(), units.end(), isRestart));
+                              }));
+
+    /* Only one restart allowed */
+    systemd->managerEmitFailed(multiple, "core-dump");
+    EXPECT_EVENTUALLY_FUNC_EQ(2u, std::function<unsigned int()>([&failures]() { return failures.load(); }));
+    settle();
+
+    auto units = systemd->unitCalls();
+    EXPECT_EQ(1, std::count_if(units.begin(), units.end(), isRestart));
+
+    /* Once it goes away we forget about it, a new crash restarts again */
+    systemd->managerEmitRemoved(SystemdMock::instanceName(multiple), SystemdMock::instancePath(multiple));
+    systemd->managerEmitNew(SystemdMock::instanceName(multiple), SystemdMock::instancePath(multiple));
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, std::function<unsigned int()>([&starts]() { return starts.load(); }));
+    systemd->managerEmitFailed(multiple);
+
+    EXPECT_EVENTUALLY_FUNC_EQ(2, std::function<int()>([&]() {
+                                  auto units = systemd->unitCalls();
+                                  return int(std::count_if(units.begin(), units.end(), isRestart));
+                              }));
+}
+
 TEST_F(JobsSystemd, SignalNew)
 {
     auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
@@ -365,6 +1188,59 @@ TEST_F(JobsSystemd, SignalRemove)
     EXPECT_EVENTUALLY_FUTURE_EQ(multipleAppID(), removeunit.get_future());
 }
 
+/* Instances another process retired are forgotten when their unit goes
+   away, even if we weren't tracking them */
+TEST_F(JobsSystemd, RetiredElsewhere)
+{
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    std::mutex lock;
+    std::list<ubuntu::app_launch::Registry::LifecycleChange> changes;
+    auto sub = ubuntu::app_launch::Registry::subscribeLifecycle(
+        {std::string{multipleAppID()}, {}, ubuntu::app_launch::Registry::LIFECYCLE_STOPPED},
+        [&lock, &changes](const ubuntu::app_launch::Registry::LifecycleChange &change) {
+            std::lock_guard<std::mutex> guard(lock);
+            changes.push_back(change);
+        },
+        registry);
+
+    /* Our own messages are ignored, so it needs to come from another connection */
+    auto address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
+    auto other = g_dbus_connection_new_for_address_sync(
+        address, (GDBusConnectionFlags)(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr, nullptr, nullptr);
+    g_free(address);
+    ASSERT_NE(nullptr, other);
+
+    g_dbus_connection_emit_signal(other, nullptr, "/", "com.canonical.UbuntuAppLaunch", "ApplicationRetired",
+                                  g_variant_new("(ss)", std::string{multipleAppID()}.c_str(), "24680"), nullptr);
+    g_dbus_connection_flush_sync(other, nullptr, nullptr);
+    settle();
+
+    /* We never saw it start, so nothing reports the stop */
+    SystemdMock::Instance retired{defaultJobName(), std::string{multipleAppID()}, "24680", 1, {}};
+    systemd->managerEmitRemoved(SystemdMock::instanceName(retired), SystemdMock::instancePath(retired));
+    settle();
+
+    /* A new instance with the same ID stops normally */
+    systemd->managerEmitNew(SystemdMock::instanceName(retired), SystemdMock::instancePath(retired));
+    settle();
+    systemd->managerEmitRemoved(SystemdMock::instanceName(retired), SystemdMock::instancePath(retired));
+
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t{1}, std::function<std::size_t()>([&lock, &changes]() {
+                                  std::lock_guard<std::mutex> guard(lock);
+                                  return changes.size();
+                              }));
+
+    std::lock_guard<std::mutex> guard(lock);
+    EXPECT_EQ("24680", changes.front().instance);
+    EXPECT_EQ(ubuntu::app_launch::Registry::StopReason::STOPPED, changes.front().stopReason);
+
+    g_object_unref(other);
+}
+
 TEST_F(JobsSystemd, UnitFailure)
 {
     auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
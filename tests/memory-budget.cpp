@@ -0,0 +1,177 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "lru-cache.h"
+#include "memory-budget.h"
+
+#include "registry-mock.h"
+
+#include <gtest/gtest.h>
+
+class MemoryBudget : public ::testing::Test
+{
+protected:
+    typedef ubuntu::app_launch::LruCache<std::string, std::string> StringCache;
+
+    std::shared_ptr<ubuntu::app_launch::MemoryBudget> budget;
+
+    virtual void SetUp()
+    {
+        budget = std::make_shared<ubuntu::app_launch::MemoryBudget>();
+        budget->setCap(0);
+    }
+
+    std::shared_ptr<StringCache> stringCache(const std::string& name)
+    {
+        return std::make_shared<StringCache>(
+            name, budget, [](const std::string& key, const std::string& value) { return value.size(); });
+    }
+
+    static std::function<std::string()> make(const std::string& value)
+    {
+        return [value]() { return value; };
+    }
+
+    ubuntu::app_launch::Registry::CacheStats findStats(const std::string& name)
+    {
+        for (const auto& stats : budget->stats())
+        {
+            if (stats.name == name)
+            {
+                return stats;
+            }
+        }
+        throw std::runtime_error{"No cache named: " + name};
+    }
+};
+
+TEST_F(MemoryBudget, HitsAndMisses)
+{
+    auto cache = stringCache("strings");
+
+    EXPECT_EQ("one", cache->get("1", make("one")));
+    EXPECT_EQ("one", cache->get("1", make("not called")));
+    EXPECT_EQ("two", cache->get("2", make("two")));
+
+    auto stats = findStats("strings");
+    EXPECT_EQ(2u, stats.entries);
+    EXPECT_EQ(6u, stats.bytes);
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(2u, stats.misses);
+    EXPECT_EQ(0u, stats.evictions);
+
+    EXPECT_EQ(6u, budget->used());
+
+    cache.reset();
+    EXPECT_TRUE(budget->stats().empty());
+}
+
+TEST_F(MemoryBudget, EvictLeastRecent)
+{
+    budget->setCap(10);
+    auto first = stringCache("first");
+    auto second = stringCache("second");
+
+    first->get("a", make("aaaa"));
+    second->get("b", make("bbbb"));
+
+    /* Using 'a' makes 'b' the oldest */
+    first->get("a", make("not called"));
+    first->get("c", make("cccc"));
+
+    EXPECT_EQ(0u, findStats("second").entries);
+    EXPECT_EQ(1u, findStats("second").evictions);
+    EXPECT_EQ(2u, findStats("first").entries);
+    EXPECT_LE(budget->used(), 10u);
+
+    /* 'b' has to be rebuilt */
+    EXPECT_EQ("bbbb", second->get("b", make("bbbb")));
+    EXPECT_EQ(2u, findStats("second").misses);
+
+    /* Shrinking the cap evicts right away */
+    budget->setCap(4);
+    EXPECT_LE(budget->used(), 4u);
+    EXPECT_EQ(1u, findStats("first").entries + findStats("second").entries);
+}
+
+TEST_F(MemoryBudget, KeepNewest)
+{
+    budget->setCap(4);
+    auto cache = stringCache("strings");
+
+    cache->get("a", make("aaaa"));
+
+    /* Bigger than the whole cap, but we just built it so it stays */
+    EXPECT_EQ("bbbbbbbb", cache->get("b", make("bbbbbbbb")));
+    EXPECT_EQ(1u, findStats("strings").entries);
+    EXPECT_EQ(1u, findStats("strings").evictions);
+    EXPECT_EQ("bbbbbbbb", cache->get("b", make("not called")));
+    EXPECT_EQ(1u, findStats("strings").hits);
+}
+
+TEST_F(MemoryBudget, AccountOnly)
+{
+    budget->setCap(10);
+    auto cache = stringCache("strings");
+    auto account = std::make_shared<ubuntu::app_launch::MemoryAccount>("account", budget);
+
+    cache->get("a", make("aaaa"));
+    account->added(8);
+
+    /* The account can't give anything back, so the cache does */
+    EXPECT_EQ(0u, findStats("strings").entries);
+    EXPECT_EQ(8u, budget->used());
+
+    /* Over budget with nothing to evict is allowed */
+    account->added(8);
+    EXPECT_EQ(16u, budget->used());
+    EXPECT_EQ(2u, findStats("account").entries);
+
+    account->removed(8);
+    account->removed(8);
+    EXPECT_EQ(0u, budget->used());
+}
+
+TEST_F(MemoryBudget, Registry)
+{
+    auto registry = std::make_shared<RegistryMock>();
+
+    registry->impl->getIconFinder(CMAKE_SOURCE_DIR "/data/usr/share");
+    registry->impl->getIconFinder(CMAKE_SOURCE_DIR "/data/usr/share");
+
+    bool found{false};
+    for (const auto& stats : ubuntu::app_launch::Registry::cacheStats(registry))
+    {
+        if (stats.name == "icon-finders")
+        {
+            found = true;
+            EXPECT_EQ(1u, stats.entries);
+            EXPECT_LT(0u, stats.bytes);
+            EXPECT_EQ(1u, stats.hits);
+            EXPECT_EQ(1u, stats.misses);
+        }
+    }
+    EXPECT_TRUE(found);
+
+    ubuntu::app_launch::Registry::setMemoryBudget(1, registry);
+    for (const auto& stats : ubuntu::app_launch::Registry::cacheStats(registry))
+    {
+        EXPECT_EQ(0u, stats.entries);
+    }
+}
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "app-store-base.h"
+#include "checkpointer-base.h"
 #include "info-watcher-zg.h"
 #include "registry-impl.h"
 #include "registry.h"
@@ -137,6 +138,15 @@ public:
                      ubuntu::app_launch::jobs::manager::launchMode,
                      std::function<std::list<std::pair<std::string, std::string>>(void)>&));
 
+    MOCK_METHOD6(activate,
+                 std::shared_ptr<ubuntu::app_launch::Application::Instance>(
+                     const ubuntu::app_launch::AppID&,
+                     const std::string&,
+                     const std::string&,
+                     const std::vector<ubuntu::app_launch::Application::URL>&,
+                     const std::vector<ubuntu::app_launch::Helper::Endpoint>&,
+                     std::function<std::list<std::pair<std::string, std::string>>(void)>&));
+
     MOCK_METHOD4(existing,
                  std::shared_ptr<ubuntu::app_launch::Application::Instance>(
                      const ubuntu::app_launch::AppID&,
@@ -180,11 +190,30 @@ public:
                  ubuntu::app_launch::Application::Info::Popularity(const ubuntu::app_launch::AppID&));
 };
 
+class MockCheckpointer : public ubuntu::app_launch::checkpointer::Base
+{
+public:
+    MockCheckpointer()
+        : ubuntu::app_launch::checkpointer::Base()
+    {
+    }
+
+    ~MockCheckpointer()
+    {
+    }
+
+    MOCK_METHOD4(dump, void(pid_t, const std::string&, GCancellable*, const std::function<void(bool)>&));
+    MOCK_METHOD1(restoreCommand, std::vector<std::string>(const std::string&));
+
+    using ubuntu::app_launch::checkpointer::Base::imageDir;
+    using ubuntu::app_launch::checkpointer::Base::restoreDir;
+};
+
 class RegistryImplMock : public ubuntu::app_launch::Registry::Impl
 {
 public:
-    RegistryImplMock()
-        : ubuntu::app_launch::Registry::Impl()
+    RegistryImplMock(const std::shared_ptr<GMainContext>& context = {})
+        : ubuntu::app_launch::Registry::Impl(context)
     {
         g_debug("Registry Mock Implementation Created");
     }
@@ -200,8 +229,8 @@ public:
 class RegistryMock : public ubuntu::app_launch::Registry
 {
 public:
-    RegistryMock()
-        : Registry(std::make_shared<RegistryImplMock>())
+    RegistryMock(const std::shared_ptr<GMainContext>& context = {})
+        : Registry(std::make_shared<RegistryImplMock>(context))
     {
         auto zgWatcher = std::make_shared<zgWatcherMock>(impl);
         ON_CALL(*zgWatcher, lookupAppPopularity(testing::_))
@@ -48,6 +48,7 @@ private:
     DbusTestDbusMockObject* managerobj = nullptr;
     GLib::ContextThread thread;
     std::list<std::pair<Instance, DbusTestDbusMockObject*>> insts;
+    std::map<std::string, std::string> activeStates;
 
     void throwError(GError* error)
     {
@@ -73,33 +74,54 @@ public:
                                                     "org.freedesktop.systemd1.Manager", nullptr);
 
         dbus_test_dbus_mock_object_add_method(mock, managerobj, "Subscribe", nullptr, nullptr, "", nullptr);
+
+        /* Not a systemd property, lets tests change the state of units */
+        dbus_test_dbus_mock_object_add_property(mock, managerobj, "MockActiveStates", G_VARIANT_TYPE("a{ss}"),
+                                                g_variant_new_array(G_VARIANT_TYPE("{ss}"), nullptr, 0), &error);
+        throwError(error);
+
+        auto units = std::string{"states = self.Get('org.freedesktop.systemd1.Manager', 'MockActiveStates')\n"
+                                 "units = [ "} +
+                     std::accumulate(instances.begin(), instances.end(), std::string{},
+                                     [](const std::string accum, const Instance& inst) {
+                                         std::string retval = accum;
+
+                                         if (!retval.empty())
+                                         {
+                                             retval += ", ";
+                                         }
+
+                                         retval += std::string{"("} +                 /* start tuple */
+                                                   "'" + instanceName(inst) + "', " + /* id */
+                                                   "'unused', " +                     /* description */
+                                                   "'unused', " +                     /* load state */
+                                                   "states.get('" + instanceName(inst) +
+                                                       "', 'unused'), " + /* active state */
+                                                   "'unused', " +                     /* substate */
+                                                   "'unused', " +                     /* following */
+                                                   "'/unused', " +                    /* path */
+                                                   "5, " +                            /* jobId */
+                                                   "'unused', " +                     /* jobType */
+                                                   "'" + instancePath(inst) + "'" +   /* jobPath */
+                                                   ")";                               /* finish tuple */
+
+                                         return retval;
+                                     }) +
+                     "]\n";
+
+        dbus_test_dbus_mock_object_add_method(mock, managerobj, "ListUnits", nullptr,
+                                              G_VARIANT_TYPE("(a(ssssssouso))"), /* ret type */
+                                              (units + "ret = units").c_str(), &error);
+        throwError(error);
+
+        /* Like systemd, units that aren't loaded come back as not found. Units
+           that aren't instances are loaded if the test gave them a state. */
         dbus_test_dbus_mock_object_add_method(
-            mock, managerobj, "ListUnits", nullptr, G_VARIANT_TYPE("(a(ssssssouso))"), /* ret type */
-            ("ret = [ " + std::accumulate(instances.begin(), instances.end(), std::string{},
-                                          [](const std::string accum, const Instance& inst) {
-                                              std::string retval = accum;
-
-                                              if (!retval.empty())
-                                              {
-                                                  retval += ", ";
-                                              }
-
-                                              retval += std::string{"("} +                 /* start tuple */
-                                                        "'" + instanceName(inst) + "', " + /* id */
-                                                        "'unused', " +                     /* description */
-                                                        "'unused', " +                     /* load state */
-                                                        "'unused', " +                     /* active state */
-                                                        "'unused', " +                     /* substate */
-                                                        "'unused', " +                     /* following */
-                                                        "'/unused', " +                    /* path */
-                                                        "5, " +                            /* jobId */
-                                                        "'unused', " +                     /* jobType */
-                                                        "'" + instancePath(inst) + "'" +   /* jobPath */
-                                                        ")";                               /* finish tuple */
-
-                                              return retval;
-                                          }) +
-             "]")
+            mock, managerobj, "ListUnitsByNames", G_VARIANT_TYPE_STRING_ARRAY,
+            G_VARIANT_TYPE("(a(ssssssouso))"), /* ret type */
+            (units + "ret = [next((unit for unit in units if unit[0] == name), "
+                     "(name, '', 'loaded' if name in states else 'not-found', states.get(name, 'inactive'), "
+                     "'dead', '', '/', 0, '', '/')) for name in args[0]]")
                 .c_str(),
             &error);
         throwError(error);
@@ -121,15 +143,19 @@ public:
 
         dbus_test_dbus_mock_object_add_method(
             mock, managerobj, "StopUnit", G_VARIANT_TYPE("(ss)"), G_VARIANT_TYPE_OBJECT_PATH, /* ret type */
-            std::accumulate(instances.begin(), instances.end(), std::string{},
-                            [](const std::string accum, const Instance& inst) {
-                                std::string retval = accum;
-
-                                retval += "if args[0] == '" + instanceName(inst) + "':\n";
-                                retval += "\tret = '" + instancePath(inst) + "'\n";
-
-                                return retval;
-                            })
+            ("ret = None\n" +
+             std::accumulate(instances.begin(), instances.end(), std::string{},
+                             [](const std::string accum, const Instance& inst) {
+                                 std::string retval = accum;
+
+                                 retval += "if args[0] == '" + instanceName(inst) + "':\n";
+                                 retval += "\tret = '" + instancePath(inst) + "'\n";
+
+                                 return retval;
+                             }) +
+             "if ret is None:\n"
+             "\traise dbus.exceptions.DBusException('Unit ' + args[0] + ' not loaded', "
+             "name='org.freedesktop.systemd1.NoSuchUnit')\n")
                 .c_str(),
             &error);
         throwError(error);
@@ -156,6 +182,11 @@ public:
                                               "", &error);
         throwError(error);
 
+        dbus_test_dbus_mock_object_add_method(mock, managerobj, "SetUnitProperties", G_VARIANT_TYPE("(sba(sv))"),
+                                              nullptr, /* ret type */
+                                              "", &error);
+        throwError(error);
+
         for (auto& instance : instances)
         {
             auto obj = dbus_test_dbus_mock_get_object(mock, instancePath(instance).c_str(),
@@ -347,14 +378,156 @@ public:
         return retval;
     }
 
+    std::list<std::string> stateCalls()
+    {
+        guint len = 0;
+        GError* error = nullptr;
+
+        auto calls = dbus_test_dbus_mock_object_get_method_calls(mock,               /* mock */
+                                                                 managerobj,         /* manager */
+                                                                 "ListUnitsByNames", /* function */
+                                                                 &len,               /* number */
+                                                                 &error              /* error */
+                                                                 );
+
+        if (error != nullptr)
+        {
+            g_warning("Unable to get 'ListUnitsByNames' calls from systemd mock: %s", error->message);
+            g_error_free(error);
+            throw std::runtime_error{"Mock disfunctional"};
+        }
+
+        std::list<std::string> retval;
+
+        for (unsigned int i = 0; i < len; i++)
+        {
+            GVariantIter* iter = nullptr;
+            const gchar* name = nullptr;
+
+            g_variant_get(calls[i].params, "(as)", &iter);
+            while (g_variant_iter_next(iter, "&s", &name))
+            {
+                retval.emplace_back(name);
+            }
+            g_variant_iter_free(iter);
+        }
+
+        return retval;
+    }
+
     struct TransientUnit
     {
         std::string name;
         std::set<std::string> environment;
         std::string execpath;
         std::list<std::string> execline;
+        std::list<std::string> stoppost; /* First ExecStopPost command line */
+        std::map<std::string, guint64> weights;
+        std::list<std::string> listen;
+        std::string busname;
+        std::string auxof; /* Set for auxiliary units, name of the unit they came with */
     };
 
+    static void parseUnitProperties(GVariant* paramarray, TransientUnit& unit)
+    {
+        gchar* ckey;
+        GVariant* var;
+        GVariantIter iter;
+        g_variant_iter_init(&iter, paramarray);
+        while (g_variant_iter_loop(&iter, "(sv)", &ckey, &var))
+        {
+            g_debug("Looking at parameter: %s", ckey);
+            std::string key{ckey};
+
+            if (key == "Environment")
+            {
+                GVariantIter array;
+                gchar* envvar;
+                g_variant_iter_init(&array, var);
+
+                while (g_variant_iter_loop(&array, "&s", &envvar))
+                {
+                    unit.environment.emplace(envvar);
+                }
+            }
+            else if (key == "ExecStart")
+            {
+                /* a(sasb) */
+                if (g_variant_n_children(var) > 1)
+                {
+                    g_warning("'ExecStart' has more than one entry, only processing the first");
+                }
+
+                auto tuple = g_variant_get_child_value(var, 0);
+
+                const gchar* cpath = nullptr;
+                g_variant_get_child(tuple, 0, "&s", &cpath);
+
+                if (cpath != nullptr)
+                {
+                    unit.execpath = cpath;
+                }
+                else
+                {
+                    g_warning("'ExecStart[0][0]' isn't a string?");
+                }
+
+                auto vexecarray = g_variant_get_child_value(tuple, 1);
+                GVariantIter execarray;
+                g_variant_iter_init(&execarray, vexecarray);
+                const gchar* execentry;
+
+                while (g_variant_iter_loop(&execarray, "&s", &execentry))
+                {
+                    unit.execline.emplace_back(execentry);
+                }
+
+                g_clear_pointer(&vexecarray, g_variant_unref);
+                g_clear_pointer(&tuple, g_variant_unref);
+            }
+            else if (key == "ExecStopPost")
+            {
+                /* a(sasb) */
+                GVariantIter commands;
+                const gchar* cpath;
+                GVariantIter* args;
+                gboolean ignore;
+                g_variant_iter_init(&commands, var);
+
+                if (g_variant_iter_next(&commands, "(&sasb)", &cpath, &args, &ignore))
+                {
+                    const gchar* arg;
+                    while (g_variant_iter_next(args, "&s", &arg))
+                    {
+                        unit.stoppost.emplace_back(arg);
+                    }
+                    g_variant_iter_free(args);
+                }
+            }
+            else if (key == "CPUWeight" || key == "IOWeight")
+            {
+                unit.weights[key] = g_variant_get_uint64(var);
+            }
+            else if (key == "Listen")
+            {
+                /* a(ss) */
+                GVariantIter array;
+                const gchar* type;
+                const gchar* address;
+                g_variant_iter_init(&array, var);
+
+                while (g_variant_iter_loop(&array, "(&s&s)", &type, &address))
+                {
+                    unit.listen.emplace_back(address);
+                }
+            }
+            else if (key == "BusName")
+            {
+                unit.busname = g_variant_get_string(var, nullptr);
+            }
+        }
+    }
+
     std::list<TransientUnit> unitCalls()
     {
         guint len = 0;
@@ -393,65 +566,27 @@ public:
             unit.name = name;
 
             auto paramarray = g_variant_get_child_value(call.params, 2);
-            gchar* ckey;
-            GVariant* var;
-            GVariantIter iter;
-            g_variant_iter_init(&iter, paramarray);
-            while (g_variant_iter_loop(&iter, "(sv)", &ckey, &var))
-            {
-                g_debug("Looking at parameter: %s", ckey);
-                std::string key{ckey};
-
-                if (key == "Environment")
-                {
-                    GVariantIter array;
-                    gchar* envvar;
-                    g_variant_iter_init(&array, var);
-
-                    while (g_variant_iter_loop(&array, "&s", &envvar))
-                    {
-                        unit.environment.emplace(envvar);
-                    }
-                }
-                else if (key == "ExecStart")
-                {
-                    /* a(sasb) */
-                    if (g_variant_n_children(var) > 1)
-                    {
-                        g_warning("'ExecStart' has more than one entry, only processing the first");
-                    }
-
-                    auto tuple = g_variant_get_child_value(var, 0);
-
-                    const gchar* cpath = nullptr;
-                    g_variant_get_child(tuple, 0, "&s", &cpath);
-
-                    if (cpath != nullptr)
-                    {
-                        unit.execpath = cpath;
-                    }
-                    else
-                    {
-                        g_warning("'ExecStart[0][0]' isn't a string?");
-                    }
+            parseUnitProperties(paramarray, unit);
+            g_variant_unref(paramarray);
 
-                    auto vexecarray = g_variant_get_child_value(tuple, 1);
-                    GVariantIter execarray;
-                    g_variant_iter_init(&execarray, vexecarray);
-                    const gchar* execentry;
+            retval.emplace_back(unit);
 
-                    while (g_variant_iter_loop(&execarray, "&s", &execentry))
-                    {
-                        unit.execline.emplace_back(execentry);
-                    }
+            /* a(sa(sv)) */
+            auto auxarray = g_variant_get_child_value(call.params, 3);
+            GVariantIter auxiter;
+            g_variant_iter_init(&auxiter, auxarray);
+            const gchar* auxname;
+            GVariant* auxprops;
 
-                    g_clear_pointer(&vexecarray, g_variant_unref);
-                    g_clear_pointer(&tuple, g_variant_unref);
-                }
+            while (g_variant_iter_loop(&auxiter, "(&s@a(sv))", &auxname, &auxprops))
+            {
+                TransientUnit auxunit;
+                auxunit.name = auxname;
+                auxunit.auxof = unit.name;
+                parseUnitProperties(auxprops, auxunit);
+                retval.emplace_back(auxunit);
             }
-            g_variant_unref(paramarray);
-
-            retval.emplace_back(unit);
+            g_variant_unref(auxarray);
         }
 
         return retval;
@@ -497,6 +632,71 @@ public:
         return retval;
     }
 
+    struct UnitProperties
+    {
+        std::string name;
+        bool runtime;
+        std::map<std::string, guint64> weights;
+    };
+
+    std::list<UnitProperties> propertiesCalls()
+    {
+        guint len = 0;
+        GError* error = nullptr;
+
+        auto calls = dbus_test_dbus_mock_object_get_method_calls(mock,                /* mock */
+                                                                 managerobj,          /* manager */
+                                                                 "SetUnitProperties", /* function */
+                                                                 &len,                /* number */
+                                                                 &error               /* error */
+                                                                 );
+
+        if (error != nullptr)
+        {
+            g_warning("Unable to get 'SetUnitProperties' calls from systemd mock: %s", error->message);
+            g_error_free(error);
+            throw std::runtime_error{"Mock disfunctional"};
+        }
+
+        std::list<UnitProperties> retval;
+
+        for (unsigned int i = 0; i < len; i++)
+        {
+            auto& call = calls[i];
+            const gchar* name = nullptr;
+            gboolean runtime = FALSE;
+            GVariantIter* iter = nullptr;
+
+            g_variant_get(call.params, "(&sba(sv))", &name, &runtime, &iter);
+
+            if (name == nullptr)
+            {
+                g_warning("Invalid 'name' on 'SetUnitProperties' call");
+                g_clear_pointer(&iter, g_variant_iter_free);
+                continue;
+            }
+
+            UnitProperties props;
+            props.name = name;
+            props.runtime = runtime == TRUE;
+
+            gchar* ckey;
+            GVariant* var;
+            while (g_variant_iter_loop(iter, "(sv)", &ckey, &var))
+            {
+                if (g_variant_is_of_type(var, G_VARIANT_TYPE_UINT64))
+                {
+                    props.weights[ckey] = g_variant_get_uint64(var);
+                }
+            }
+            g_variant_iter_free(iter);
+
+            retval.emplace_back(props);
+        }
+
+        return retval;
+    }
+
     void managerClear()
     {
         GError* error = nullptr;
@@ -569,6 +769,34 @@ public:
         }
     }
 
+    void managerSetActiveState(const Instance& inst, const std::string& state)
+    {
+        managerSetActiveState(instanceName(inst), state);
+    }
+
+    void managerSetActiveState(const std::string& name, const std::string& state)
+    {
+        activeStates[name] = state;
+
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE("a{ss}"));
+        for (const auto& entry : activeStates)
+        {
+            g_variant_builder_add(&builder, "{ss}", entry.first.c_str(), entry.second.c_str());
+        }
+
+        GError* error = nullptr;
+        dbus_test_dbus_mock_object_update_property(mock, managerobj, "MockActiveStates",
+                                                   g_variant_builder_end(&builder), &error);
+
+        if (error != nullptr)
+        {
+            g_warning("Unable to set active state to '%s': %s", state.c_str(), error->message);
+            g_error_free(error);
+            throw std::runtime_error{"Mock disfunctional"};
+        }
+    }
+
     std::function<DbusTestTaskState()> stateFunc()
     {
         return [this] { return dbus_test_task_get_state(DBUS_TEST_TASK(mock)); };
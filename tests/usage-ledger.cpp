@@ -0,0 +1,222 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "usage-ledger.h"
+
+#include "eventually-fixture.h"
+#include "registry-mock.h"
+
+#include <glib/gstdio.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <libdbustest/dbus-test.h>
+
+#define LEDGER_FILE (CMAKE_BINARY_DIR "/usage-ledger-test")
+
+class UsageLedger : public EventuallyFixture
+{
+protected:
+    std::shared_ptr<DbusTestService> service;
+    std::shared_ptr<RegistryMock> registry;
+
+    virtual void SetUp()
+    {
+        g_setenv("UBUNTU_APP_LAUNCH_USAGE_LEDGER", LEDGER_FILE, TRUE);
+        g_unlink(LEDGER_FILE);
+
+        service = std::shared_ptr<DbusTestService>(dbus_test_service_new(nullptr),
+                                                   [](DbusTestService* service) { g_clear_object(&service); });
+        dbus_test_service_start_tasks(service.get());
+        registry = std::make_shared<RegistryMock>();
+    }
+
+    virtual void TearDown()
+    {
+        registry.reset();
+        service.reset();
+
+        g_unlink(LEDGER_FILE);
+        g_unsetenv("UBUNTU_APP_LAUNCH_USAGE_LEDGER");
+    }
+
+    ubuntu::app_launch::AppID simpleAppID()
+    {
+        return {ubuntu::app_launch::AppID::Package::from_raw("package"),
+                ubuntu::app_launch::AppID::AppName::from_raw("appname"),
+                ubuntu::app_launch::AppID::Version::from_raw("version")};
+    }
+
+    /* Send a pause signal like another process pausing the app would */
+    void emitPauseSignal(const std::string& signal, const std::string& appid, const std::string& instance)
+    {
+        GVariantBuilder pids;
+        g_variant_builder_init(&pids, G_VARIANT_TYPE("at"));
+        g_variant_builder_add(&pids, "t", guint64{100});
+
+        g_dbus_connection_emit_signal(registry->impl->_dbus.get(),                                      /* bus */
+                                      nullptr,                                                          /* destination */
+                                      "/",                                                              /* path */
+                                      "com.canonical.UbuntuAppLaunch",                                  /* interface */
+                                      signal.c_str(),                                                   /* signal */
+                                      g_variant_new("(ss@at)", appid.c_str(), instance.c_str(),         /* params */
+                                                    g_variant_builder_end(&pids)),
+                                      nullptr);                                                         /* error */
+    }
+};
+
+TEST_F(UsageLedger, Empty)
+{
+    auto ledger = std::make_shared<ubuntu::app_launch::UsageLedger>(registry->impl);
+    registry->impl->setUsageLedger(ledger);
+
+    auto usage = ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry);
+    EXPECT_EQ(0, usage.foregroundTime.count());
+    EXPECT_EQ(0u, usage.launches);
+    EXPECT_EQ(std::chrono::system_clock::time_point{}, usage.lastUsed);
+
+    EXPECT_TRUE(ubuntu::app_launch::Registry::allAppUsage(registry).empty());
+}
+
+TEST_F(UsageLedger, ForegroundTime)
+{
+    auto ledger = std::make_shared<ubuntu::app_launch::UsageLedger>(registry->impl);
+    std::string appid = simpleAppID();
+
+    auto before = std::chrono::system_clock::now();
+    ledger->started(appid, "1");
+    pause(100);
+    ledger->paused(appid, "1");
+
+    auto usage = ledger->usage(appid);
+    EXPECT_LE(100, usage.foregroundTime.count());
+    EXPECT_EQ(1u, usage.launches);
+    EXPECT_LE(before, usage.lastUsed);
+
+    /* Paused time doesn't count */
+    pause(100);
+    EXPECT_EQ(usage.foregroundTime, ledger->usage(appid).foregroundTime);
+
+    /* Two instances in the foreground only count once */
+    ledger->resumed(appid, "1");
+    ledger->started(appid, "2");
+    pause(100);
+    ledger->stopped(appid, "2");
+    ledger->paused(appid, "1");
+
+    auto twoinst = ledger->usage(appid);
+    EXPECT_LE(usage.foregroundTime.count() + 100, twoinst.foregroundTime.count());
+    EXPECT_GT(usage.foregroundTime.count() + 200, twoinst.foregroundTime.count());
+    EXPECT_EQ(2u, twoinst.launches);
+
+    /* Pausing again doesn't add anything */
+    ledger->paused(appid, "1");
+    EXPECT_EQ(twoinst.foregroundTime, ledger->usage(appid).foregroundTime);
+}
+
+TEST_F(UsageLedger, Persist)
+{
+    std::string appid = simpleAppID();
+    auto ledger = std::make_shared<ubuntu::app_launch::UsageLedger>(registry->impl);
+
+    ledger->started(appid, "1");
+    pause(10);
+    ledger->stopped(appid, "1");
+    ledger->started("other-app", {});
+    ledger->stopped("other-app", {});
+
+    auto usage = ledger->usage(appid);
+
+    /* Saved after a bit */
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([]() {
+                                  return g_file_test(LEDGER_FILE, G_FILE_TEST_EXISTS) == TRUE;
+                              }));
+
+    ledger.reset();
+
+    auto reloaded = std::make_shared<ubuntu::app_launch::UsageLedger>(registry->impl);
+    auto reusage = reloaded->usage(appid);
+
+    EXPECT_EQ(usage.foregroundTime, reusage.foregroundTime);
+    EXPECT_EQ(usage.launches, reusage.launches);
+    EXPECT_EQ(std::chrono::duration_cast<std::chrono::milliseconds>(usage.lastUsed.time_since_epoch()),
+              std::chrono::duration_cast<std::chrono::milliseconds>(reusage.lastUsed.time_since_epoch()));
+
+    EXPECT_EQ(2u, reloaded->allUsage().size());
+}
+
+TEST_F(UsageLedger, JobEvents)
+{
+    core::Signal<const std::string&, const std::string&, const std::string&> started;
+    core::Signal<const std::string&, const std::string&, const std::string&> stopped;
+    core::Signal<const std::string&, const std::string&, const std::string&, ubuntu::app_launch::Registry::FailureType>
+        failed;
+
+    auto manager = std::make_shared<MockJobsManager>(registry->impl);
+    EXPECT_CALL(*manager, jobStarted()).WillRepeatedly(testing::ReturnRef(started));
+    EXPECT_CALL(*manager, jobStopped()).WillRepeatedly(testing::ReturnRef(stopped));
+    EXPECT_CALL(*manager, jobFailed()).WillRepeatedly(testing::ReturnRef(failed));
+    registry->impl->setJobs(manager);
+
+    /* Only kept when asked for */
+    EXPECT_FALSE(bool(registry->impl->getUsageLedger()));
+    ubuntu::app_launch::Registry::trackUsage(registry);
+    ASSERT_TRUE(bool(registry->impl->getUsageLedger()));
+
+    started("application-legacy", simpleAppID(), "1");
+    started("untrusted-helper", simpleAppID(), "2");
+
+    EXPECT_EQ(1u, ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry).launches);
+
+    auto all = ubuntu::app_launch::Registry::allAppUsage(registry);
+    ASSERT_EQ(1u, all.size());
+    EXPECT_EQ(simpleAppID(), all.begin()->first);
+
+    /* Pauses come from the signal, whoever sends it */
+    auto launched = ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry).lastUsed;
+    pause(10);
+    emitPauseSignal("ApplicationPaused", simpleAppID(), "1");
+
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([&]() {
+                                  return ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry).lastUsed !=
+                                         launched;
+                              }));
+
+    auto paused = ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry).foregroundTime;
+    pause(50);
+    EXPECT_EQ(paused, ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry).foregroundTime);
+
+    stopped("application-legacy", simpleAppID(), "1");
+}
+
+TEST_F(UsageLedger, SavedUsage)
+{
+    auto ledger = std::make_shared<ubuntu::app_launch::UsageLedger>(registry->impl);
+    ledger->started(simpleAppID(), "1");
+    ledger->stopped(simpleAppID(), "1");
+    ledger->save();
+
+    /* A registry that isn't tracking reads what was saved */
+    EXPECT_FALSE(bool(registry->impl->getUsageLedger()));
+    EXPECT_EQ(1u, ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry).launches);
+    EXPECT_EQ(1u, ubuntu::app_launch::Registry::allAppUsage(registry).size());
+
+    ledger->started(simpleAppID(), "2");
+    ledger->save();
+    EXPECT_EQ(2u, ubuntu::app_launch::Registry::appUsage(simpleAppID(), registry).launches);
+}
@@ -71,6 +71,8 @@ int main(int argc, char* argv[])
             case ubuntu::app_launch::Registry::FailureType::START_FAILURE:
                 std::cout << " (start failure)";
                 break;
+            case ubuntu::app_launch::Registry::FailureType::NONE:
+                break;
         }
         std::cout << std::endl;
     });